@@ -22,12 +22,26 @@
 // into groups. The first group represents the DWISLPY interpreter by giving
 // the code for 
 //
-//    Prgm::run, Blck::exec, Stmt::exec, Expn::eval
+//    Prgm::walk, Blck::exec, Stmt::exec, Expn::eval
+//
+// (Prgm::run instead runs the program with the bytecode interpreter
+// in dwislpy-byte.cc.)
 //
 // The second group AST::output and AST::dump performs pretty printing
 // of SLPY code and also the output of the AST, resp.
 //
 
+//
+// AST::operator new(size)
+//
+// Hand out the memory for a node from the AST's arena, so that the
+// nodes the parser builds one after another sit next to each other.
+//
+void* AST::operator new(std::size_t size) {
+    static Arena arena { };
+    return arena.allocate(size);
+}
+
 //
 // to_string
 //
@@ -37,8 +51,8 @@
 std::string to_string(Valu v) {
     if (std::holds_alternative<int>(v)) {
         return std::to_string(std::get<int>(v));
-    } else if (std::holds_alternative<std::string>(v)) {
-        return std::get<std::string>(v);
+    } else if (std::holds_alternative<Strg>(v)) {
+        return std::get<Strg>(v).str();
     } else if (std::holds_alternative<bool>(v)) {
         if (std::get<bool>(v)) {
             return "True";
@@ -61,12 +75,12 @@ std::string to_string(Valu v) {
 // a literal value.
 //
 std::string to_repr(Valu v) {
-    if (std::holds_alternative<std::string>(v)) {
+    if (std::holds_alternative<Strg>(v)) {
         //
         // Strings have to be converted to show their quotes and also
         // to have the unprintable chatacters given as \escape sequences.
         //
-        return "\"" + re_escape(std::get<std::string>(v)) + "\"";
+        return "\"" + re_escape(std::get<Strg>(v).str()) + "\"";
     } else {
         //
         // The other types aren't special. (This will have to change when
@@ -83,27 +97,44 @@ std::string to_repr(Valu v) {
 //
 
 //
-// Prgm::run, Blck::exec, Stmt::exec
+// Prgm::walk, Blck::exec, Stmt::exec
 //
-//  - execute DWISLPY statements, changing the runtime context mapping
-//    variables to their current values.
+//  - execute DWISLPY statements, changing the runtime context that
+//    holds the current values of variables at their frame slots.
 //
 
-void Prgm::run(void) const {
-    Ctxt main_ctxt { };
+Ctxt::Ctxt(unsigned int size) : base {(unsigned int)stack().size()} {
+    stack().resize(base + size);
+}
+
+Ctxt::~Ctxt(void) {
+    stack().resize(base);
+}
+
+std::vector<Valu>& Ctxt::stack(void) {
+    static std::vector<Valu> values { };
+    return values;
+}
+
+void Prgm::walk(void) const {
+    Ctxt main_ctxt { main_symt.get_frmls_size() + main_symt.get_locls_size() };
     main->exec(defs,main_ctxt);
 }
 
 std::optional<Valu> Defn::call(const Defs& defs,
                                const Expn_vec& args,
                                const Ctxt& ctxt) {
-    Ctxt locals {};
-    int i=0;
-    for (Expn_ptr expn : args) {
-        std::string local = formal(i)->name;
-        i++;
-        Valu value = expn->eval(defs,ctxt);
-        locals[local] = value;
+    //
+    // The formals are entered into `symt` before any local, so the
+    // `i`-th formal has index `i`. Each argument is evaluated in the
+    // caller's frame and moved straight into its slot of the callee's
+    // frame. The argument is evaluated before `locals[i]` is looked up
+    // (C++17 sequences the right of `=` first), which matters because
+    // a call made while evaluating it can grow the stack.
+    //
+    Ctxt locals { symt.get_frmls_size() + symt.get_locls_size() };
+    for (unsigned int i = 0; i < args.size(); i++) {
+        locals[i] = args[i]->eval(defs,ctxt);
     }
     return body->exec(defs, locals);
 }
@@ -120,13 +151,15 @@ std::optional<Valu> Blck::exec(const Defs& defs, Ctxt& ctxt) const {
 
 std::optional<Valu> Asgn::exec(const Defs& defs,
                                Ctxt& ctxt) const {
-    ctxt[name] = expn->eval(defs,ctxt);
+    Valu value = expn->eval(defs,ctxt);
+    ctxt[slot] = value;
     return std::nullopt;
 }
 
 std::optional<Valu> Ntro::exec(const Defs& defs,
                                Ctxt& ctxt) const {
-    ctxt[name] = expn->eval(defs,ctxt);
+    Valu value = expn->eval(defs,ctxt);
+    ctxt[slot] = value;
     return std::nullopt;
 }
 
@@ -165,11 +198,15 @@ Valu Plus::eval(const Defs& defs, const Ctxt& ctxt) const {
         int ln = std::get<int>(lv);
         int rn = std::get<int>(rv);
         return Valu {ln + rn};
-    } else if (std::holds_alternative<std::string>(lv)
-               && std::holds_alternative<std::string>(rv)) {
-        std::string ls = std::get<std::string>(lv);
-        std::string rs = std::get<std::string>(rv);
-        return Valu {ls + rs};
+    } else if (std::holds_alternative<Strg>(lv)
+               && std::holds_alternative<Strg>(rv)) {
+        const std::string& ls = std::get<Strg>(lv).str();
+        const std::string& rs = std::get<Strg>(rv).str();
+        std::string sum { };
+        sum.reserve(ls.size() + rs.size());
+        sum += ls;
+        sum += rs;
+        return Valu {Strg {std::move(sum)}};
     } else {
         std::string msg = "Run-time error: wrong operand type for plus.";
         throw DwislpyError { where(), msg };
@@ -184,10 +221,10 @@ Valu Less::eval(const Defs& defs, const Ctxt& ctxt) const {
         int ln = std::get<int>(lv);
         int rn = std::get<int>(rv);
         return Valu {ln < rn};
-    } else if (std::holds_alternative<std::string>(lv)
-               && std::holds_alternative<std::string>(rv)) {
-        std::string ls = std::get<std::string>(lv);
-        std::string rs = std::get<std::string>(rv);
+    } else if (std::holds_alternative<Strg>(lv)
+               && std::holds_alternative<Strg>(rv)) {
+        const std::string& ls = std::get<Strg>(lv).str();
+        const std::string& rs = std::get<Strg>(rv).str();
         return Valu {ls < rs};
     } else if (std::holds_alternative<bool>(lv)
                && std::holds_alternative<bool>(rv)) {
@@ -222,21 +259,14 @@ Valu Ltrl::eval([[maybe_unused]] const Defs& defs,
 }
 
 Valu Lkup::eval([[maybe_unused]] const Defs& defs, const Ctxt& ctxt) const {
-    if (ctxt.count(name) > 0) {
-        return ctxt.at(name);
-    } else {
-        std::string msg = "Run-time error: variable '" + name +"'";
-        msg += "not defined.";
-        throw DwislpyError { where(), msg };
-    }
+    return ctxt[slot];
 }
 
 Valu Inpt::eval([[maybe_unused]] const Defs& defs, const Ctxt& ctxt) const {
     Valu v = expn->eval(defs,ctxt);
-    if (std::holds_alternative<std::string>(v)) {
+    if (std::holds_alternative<Strg>(v)) {
         //
-        std::string prompt = std::get<std::string>(v);
-        std::cout << prompt;
+        std::cout << std::get<Strg>(v).str();
         //
         // Should be a std::string as follows
         //     std::string vl;
@@ -35,13 +35,17 @@
 #include "dwislpy-util.hh"
 #include "dwislpy-check.hh"
 #include "dwislpy-inst.hh"
+#include "dwislpy-byte.hh"
+#include "dwislpy-opt.hh"
 
 // Valu
 //
-// The return type of `eval` and of literal values.
+// The return type of `eval` and of literal values. Each is a small
+// tagged value: an `int` or `bool` is held directly and a `str` as a
+// `Strg`, so that values are cheap to copy.
 // Note: the type `none` is defined in *-util.hh.
 //
-typedef std::variant<int, bool, std::string, none> Valu;
+typedef std::variant<int, bool, Strg, none> Valu;
 typedef std::optional<Valu> RtnO;
 
 //
@@ -87,29 +91,51 @@ class FCll;
 //
 typedef std::string Labl;
 typedef std::string Name;
-typedef std::unordered_map<Name,Valu> Ctxt;
-//
-typedef std::shared_ptr<Lkup> Lkup_ptr; 
-typedef std::shared_ptr<Ltrl> Ltrl_ptr; 
-typedef std::shared_ptr<IntC> IntC_ptr; 
-typedef std::shared_ptr<StrC> StrC_ptr; 
-typedef std::shared_ptr<Inpt> Inpt_ptr; 
-typedef std::shared_ptr<Plus> Plus_ptr; 
-typedef std::shared_ptr<Less> Less_ptr;
-typedef std::shared_ptr<And>  And_ptr;
-//
-typedef std::shared_ptr<Pass> Pass_ptr; 
-typedef std::shared_ptr<Prnt> Prnt_ptr; 
-typedef std::shared_ptr<Ntro> Ntro_ptr;
-typedef std::shared_ptr<Asgn> Asgn_ptr;
-typedef std::shared_ptr<PRtn> PRtn_ptr;
-typedef std::shared_ptr<FRtn> FRtn_ptr;
-//
-typedef std::shared_ptr<Prgm> Prgm_ptr; 
-typedef std::shared_ptr<Defn> Defn_ptr; 
-typedef std::shared_ptr<Blck> Blck_ptr; 
-typedef std::shared_ptr<Stmt> Stmt_ptr; 
-typedef std::shared_ptr<Expn> Expn_ptr;
+//
+// class Ctxt
+//
+// The frame of a running `def` (or of the main script) for the
+// tree-walking interpreter. It holds the value of each formal and
+// local at the index given to it by the symbol table (`SymInfo::index`),
+// which `chck` records in the `Lkup`, `Asgn`, and `Ntro` nodes that use
+// the variable. All frames are carved out of one `Valu` stack: making
+// a frame takes the next `size` entries, and destroying it gives them
+// back, so that calls reuse the same storage rather than allocate.
+//
+class Ctxt {
+public:
+    Ctxt(unsigned int size);
+    ~Ctxt(void);
+    Ctxt(const Ctxt&) = delete;
+    Ctxt& operator=(const Ctxt&) = delete;
+    Valu& operator[](int index) { return stack()[base+index]; }
+    const Valu& operator[](int index) const { return stack()[base+index]; }
+private:
+    static std::vector<Valu>& stack(void);
+    unsigned int base;
+};
+//
+typedef Lkup* Lkup_ptr; 
+typedef Ltrl* Ltrl_ptr; 
+typedef IntC* IntC_ptr; 
+typedef StrC* StrC_ptr; 
+typedef Inpt* Inpt_ptr; 
+typedef Plus* Plus_ptr; 
+typedef Less* Less_ptr;
+typedef And*  And_ptr;
+//
+typedef Pass* Pass_ptr; 
+typedef Prnt* Prnt_ptr; 
+typedef Ntro* Ntro_ptr;
+typedef Asgn* Asgn_ptr;
+typedef PRtn* PRtn_ptr;
+typedef FRtn* FRtn_ptr;
+//
+typedef Prgm* Prgm_ptr; 
+typedef Defn* Defn_ptr; 
+typedef Blck* Blck_ptr; 
+typedef Stmt* Stmt_ptr; 
+typedef Expn* Expn_ptr;
 //
 typedef std::vector<Stmt_ptr> Stmt_vec;
 typedef std::vector<Expn_ptr> Expn_vec;
@@ -133,11 +159,17 @@ typedef std::unordered_map<Name,Defn_ptr> Defs;
 // I.e. this is *the* abstract class (in the OO sense) that all
 // the AST node subclasses are derived from.
 //
+// Nodes are allocated from an arena with `new` (see `AST::operator new`
+// in `dwislpy-ast.cc`), and they live until the compiler exits. So each
+// `X_ptr` type is a plain pointer, and nodes are never deleted.
+//
 
 class AST {
 private:
     Locn locn; // Location of construct in source code (for reporting errors).
 public:
+    static void* operator new(std::size_t size);
+    static void operator delete([[maybe_unused]] void* node) { }
     AST(Locn lo) : locn {lo} { }
     virtual ~AST(void) = default;
     virtual void output(std::ostream& os) const = 0;
@@ -175,11 +207,15 @@ public:
     virtual ~Prgm(void) = default;
     //
     virtual void chck(void);                     // Verify the code.
+    virtual void fold(void);                     // Fold constants.
     virtual void dump(int level = 0) const;
     virtual void run(void) const;                // Execute the program.
+    virtual void walk(void) const;               // Execute the AST.
+    virtual Bytc bcode(void) const;              // Compile to bytecode.
     virtual void output(std::ostream& os) const; // Output formatted code.
     virtual void trans(void);                    // Translate to IR. (HW5)
-    virtual void compile(std::ostream& os);      // Generate MIPS. (HW5)
+    virtual void compile(std::ostream& os,       // Generate MIPS. (HW5)
+                         const Opts& opts);
 };
 
 //
@@ -206,6 +242,7 @@ public:
     SymInfo_ptr formal(int i) const;
     //
     virtual void chck(Defs& defs);
+    virtual void fold(void);
     std::optional<Valu> call(const Defs& defs,
                              const Expn_vec& args, const Ctxt& ctxt);
     virtual void dump(int level = 0) const;
@@ -228,6 +265,10 @@ public:
 //
 //  * exec(ctxt): execute the statement within the stack frame
 //
+//  * fold(): fold the constant parts of its expressions
+//
+//  * bcode(bc): compile the statement into the bytecode `bc`
+//
 //  * output(os), output(os,indent): output formatted DwiSlpy code of
 //        the statement to the output stream `os`. The `indent` string
 //        gives us a string of spaces for indenting the lines of its
@@ -240,11 +281,13 @@ public:
     Stmt(Locn lo) : AST {lo} { }
     virtual ~Stmt(void) = default;
     virtual Rtns chck(Rtns expd, Defs& defs, SymT& symt) = 0;
+    virtual void fold(void) { }
     virtual std::optional<Valu> exec(const Defs& defs, Ctxt& ctxt) const = 0;
     virtual void output(std::ostream& os, std::string indent) const = 0;
     virtual void output(std::ostream& os) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code) = 0;
                                               // Generate IR code. (HW5)
+    virtual void bcode(Bytc& bc) const = 0;   // Generate bytecode.
 };
 
 //
@@ -255,14 +298,17 @@ public:
     Name     name;
     Type type;
     Expn_ptr expn;
+    int      slot; // Its index in the frame, set by `chck`.
     Ntro(Name x, Type t, Expn_ptr e, Locn l) :
         Stmt {l}, name {x}, type {t},expn {e} { }
     virtual ~Ntro(void) = default;
     virtual Rtns chck(Rtns expd, Defs& defs, SymT& symt);
+    virtual void fold(void);
     virtual std::optional<Valu> exec(const Defs& defs, Ctxt& ctxt) const;
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 //
@@ -272,13 +318,16 @@ class Asgn : public Stmt {
 public:
     Name     name;
     Expn_ptr expn;
+    int      slot; // Its index in the frame, set by `chck`.
     Asgn(Name x, Expn_ptr e, Locn l) : Stmt {l}, name {x}, expn {e} { }
     virtual ~Asgn(void) = default;
     virtual Rtns chck(Rtns expd, Defs& defs, SymT& symt);
+    virtual void fold(void);
     virtual std::optional<Valu> exec(const Defs& defs, Ctxt& ctxt) const;
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 //
@@ -290,10 +339,12 @@ public:
     Prnt(Expn_ptr e, Locn l) : Stmt {l}, expn {e} { }
     virtual ~Prnt(void) = default;
     virtual Rtns chck(Rtns expd, Defs& defs, SymT& symt);
+    virtual void fold(void);
     virtual std::optional<Valu> exec(const Defs& defs, Ctxt& ctxt) const;
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 
@@ -309,6 +360,7 @@ public:
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 class PRtn : public Stmt {
@@ -320,6 +372,7 @@ public:
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 class FRtn : public Stmt {
@@ -328,10 +381,12 @@ public:
     FRtn(Expn_ptr e, Locn l) : Stmt {l}, expn {e} { }
     virtual ~FRtn(void) = default;
     virtual Rtns chck(Rtns expd, Defs& defs, SymT& symt);
+    virtual void fold(void);
     virtual std::optional<Valu> exec(const Defs& defs, Ctxt& ctxt) const;
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 //
@@ -343,13 +398,15 @@ class Blck : public AST {
 public:
     Stmt_vec stmts;
     virtual ~Blck(void) = default;
-    Blck(Stmt_vec ss, Locn lo) : AST {lo}, stmts {ss}  { }
+    Blck(Stmt_vec ss, Locn lo) : AST {lo}, stmts {std::move(ss)}  { }
     virtual Rtns chck(Rtns expd, Defs& defs, SymT& symt);
+    virtual void fold(void);
     virtual std::optional<Valu> exec(const Defs& defs, Ctxt& ctxt) const;
     virtual void output(std::ostream& os, std::string indent) const;
     virtual void output(std::ostream& os) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string exit, SymT& symt, INST_vec& code);
+    virtual void bcode(Bytc& bc) const;
 };
 
 
@@ -370,6 +427,9 @@ public:
 // These each support the methods:
 //
 //  * eval(ctxt): evaluate the expression; return its result
+//  * fold(): fold its constant parts, giving the expression that
+//        should take its place (possibly itself)
+//  * bcode(bc,dest): compile the expression into the bytecode `bc`
 //  * output(os): output formatted DwiSlpy code of the expression.
 //  * dump: output the syntax tree of the expression
 //
@@ -379,10 +439,12 @@ public:
     Expn(Locn lo) : AST {lo} { }
     virtual ~Expn(void) = default;
     virtual Type chck(Defs& defs, SymT& symt) = 0;
+    virtual Expn_ptr fold(void) { return this; }
     virtual Valu eval(const Defs& defs, const Ctxt& ctxt) const = 0;
     virtual void trans(Name dest, SymT& symt, INST_vec& code) = 0;
     virtual void trans_cndn(std::string then_lbl, std::string else_lbl,
                             SymT& symt, INST_vec& code); // Generate IR (HW5)
+    virtual int bcode(Bytc& bc, int dest) const = 0;   // Generate bytecode.
                 
 };
 
@@ -397,10 +459,12 @@ public:
         : Expn {lo}, left {lf}, rght {rg} { }
     virtual ~Plus(void) = default;
     virtual Type chck(Defs& defs, SymT& symt);
+    virtual Expn_ptr fold(void);
     virtual Valu eval(const Defs& defs, const Ctxt& ctxt) const;
     virtual void output(std::ostream& os) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string dest, SymT& symt, INST_vec& code);
+    virtual int bcode(Bytc& bc, int dest) const;
 };
 
 class Less : public Expn {
@@ -411,11 +475,13 @@ public:
         : Expn {lo}, left {lf}, rght {rg} { }
     virtual ~Less(void) = default;
     virtual Type chck(Defs& defs, SymT& symt);
+    virtual Expn_ptr fold(void);
     virtual Valu eval(const Defs& defs, const Ctxt& ctxt) const;
     virtual void output(std::ostream& os) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string dest, SymT& symt, INST_vec& code);
     virtual void trans_cndn(std::string then_lbl, std::string else_lbl, SymT& symt, INST_vec& code);
+    virtual int bcode(Bytc& bc, int dest) const;
 };
 
 class LsEq : public Expn {
@@ -443,11 +509,13 @@ public:
         : Expn {lo}, left {lf}, rght {rg} { }
     virtual ~And(void) = default;
     virtual Type chck(Defs& defs, SymT& symt);
+    virtual Expn_ptr fold(void);
     virtual Valu eval(const Defs& defs, const Ctxt& ctxt) const;
     virtual void output(std::ostream& os) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string dest, SymT& symt, INST_vec& code);
     virtual void trans_cndn(std::string then_lbl, std::string else_lbl, SymT& symt, INST_vec& code);
+    virtual int bcode(Bytc& bc, int dest) const;
 };
 
 //
@@ -464,6 +532,7 @@ public:
     virtual void dump(int level = 0) const;
     virtual void trans(std::string dest, SymT& symt, INST_vec& code);
     virtual void trans_cndn(std::string then_lbl, std::string else_lbl, SymT& symt, INST_vec& code);
+    virtual int bcode(Bytc& bc, int dest) const;
 };
 
 //
@@ -472,6 +541,7 @@ public:
 class Lkup : public Expn {
 public:
     Name name;
+    int  slot; // Its index in the frame, set by `chck`.
     Lkup(Name nm, Locn lo) : Expn {lo}, name {nm} { }
     virtual ~Lkup(void) = default;
     virtual Type chck(Defs& defs, SymT& symt);
@@ -480,6 +550,7 @@ public:
     virtual void dump(int level = 0) const;
     virtual void trans(std::string dest, SymT& symt, INST_vec& code);
     virtual void trans_cndn(std::string then_lbl, std::string else_lbl, SymT& symt, INST_vec& code);
+    virtual int bcode(Bytc& bc, int dest) const;
 };
 
 //
@@ -491,10 +562,12 @@ public:
     Inpt(Expn_ptr e, Locn lo) : Expn {lo}, expn {e} { }
     virtual ~Inpt(void) = default;
     virtual Type chck(Defs& defs, SymT& symt);
+    virtual Expn_ptr fold(void);
     virtual Valu eval(const Defs& defs, const Ctxt& ctxt) const;
     virtual void output(std::ostream& os) const;
     virtual void dump(int level = 0) const;
     virtual void trans(std::string dest, SymT& symt, INST_vec& code);
+    virtual int bcode(Bytc& bc, int dest) const;
 };
 
 #endif
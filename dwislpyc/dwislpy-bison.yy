@@ -126,10 +126,9 @@ defs: defn {
       $$ = ds;
   }
 | defs defn {
-      Defs ds = $1;
       Defn_ptr d = $2;
-      ds[d->name] = d;
-      $$ = ds;
+      $$ = std::move($1);
+      $$[d->name] = d;
   }
 ;
 
@@ -157,9 +156,8 @@ fmls:
     $$ = ps;
   }
 | fmls CMMA NAME COLN type {
-    SymT ps = $1;
-    ps.add_frml($3,$5);
-    $$ = ps;
+    $$ = std::move($1);
+    $$.add_frml($3,$5);
   }
 ;
 
@@ -186,16 +184,15 @@ nest:
 
 blck:
   stms {
-      Stmt_vec ss = $1;
-      $$ = Blck_ptr { new Blck {ss, ss[0]->where()} };
+      Locn lo = $1[0]->where();
+      $$ = Blck_ptr { new Blck {std::move($1), lo} };
   }
 ;
 
 stms:
   stms stmt {
-      Stmt_vec ss = $1;
-      ss.push_back($2);
-      $$ = ss;
+      $$ = std::move($1);
+      $$.push_back($2);
   }
 | stmt {
       Stmt_vec ss { };
@@ -239,7 +236,7 @@ expn:
       $$ = Ltrl_ptr { new Ltrl {Valu {$1},lexer.locate(@1)} };
   }
 | STRG {
-      $$ = Ltrl_ptr { new Ltrl {Valu {de_escape($1)},lexer.locate(@1)} };
+      $$ = Ltrl_ptr { new Ltrl {Valu {Strg::literal(de_escape($1))},lexer.locate(@1)} };
   }
 | TRUE {
       $$ = Ltrl_ptr { new Ltrl {Valu {true},lexer.locate(@1)} };
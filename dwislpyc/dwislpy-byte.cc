@@ -0,0 +1,371 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "dwislpy-ast.hh"
+#include "dwislpy-byte.hh"
+#include "dwislpy-check.hh"
+#include "dwislpy-util.hh"
+
+//
+// dwislpy-byte.cc
+//
+// This gives the bytecode interpreter used by `Prgm::run`. It has
+// three parts:
+//
+//  * the methods of `Bytc` that lay out registers and collect code,
+//  * the `bcode` methods for all the supported AST nodes, which
+//    compile a checked AST into a `Bytc`, and
+//  * `Bytc::exec`, the loop that executes the compiled code.
+//
+
+//
+// Bytc(symt)
+//
+// Lay out the register files for code whose variables are described
+// by `symt`. Formal parameters come first, in order, and then the
+// locals in the order `chck` introduced them.
+//
+Bytc::Bytc(const SymT& symt) {
+    for (unsigned int i = 0; i < symt.get_frmls_size(); i++) {
+        SymInfo_ptr info = symt.get_frml(i);
+        intro(info->name, info->type);
+    }
+    for (unsigned int i = 0; i < symt.get_locls_size(); i++) {
+        SymInfo_ptr info = symt.get_locl(i);
+        if (info->kind == LOCL) {
+            intro(info->name, info->type);
+        }
+    }
+}
+
+int Bytc::slot(std::string nm, Type ty) const {
+    const std::unordered_map<std::string, int>& slots =
+        is_str(ty) ? str_slots : int_slots;
+    if (slots.count(nm) == 0) {
+        return -1;
+    }
+    return slots.at(nm);
+}
+
+int Bytc::intro(std::string nm, Type ty) {
+    int reg = slot(nm,ty);
+    if (reg >= 0) {
+        return reg;
+    }
+    if (is_str(ty)) {
+        reg = str_vars++;
+        str_slots[nm] = reg;
+        str_size = std::max(str_size, str_vars);
+    } else {
+        reg = int_vars++;
+        int_slots[nm] = reg;
+        int_size = std::max(int_size, int_vars);
+    }
+    return reg;
+}
+
+int Bytc::temp(Type ty) {
+    if (is_str(ty)) {
+        int reg = str_vars + str_temps++;
+        str_size = std::max(str_size, reg + 1);
+        return reg;
+    } else {
+        int reg = int_vars + int_temps++;
+        int_size = std::max(int_size, reg + 1);
+        return reg;
+    }
+}
+
+void Bytc::free_temps(void) {
+    int_temps = 0;
+    str_temps = 0;
+}
+
+int Bytc::strg(Strg s) {
+    if (string_index.count(s) == 0) {
+        string_index.emplace(s, strings.size());
+        strings.push_back(s.str());
+    }
+    return string_index.at(s);
+}
+
+int Bytc::emit(Opcd op, int dst, int src1, int src2) {
+    code.push_back(Bcod {op, dst, src1, src2});
+    return code.size() - 1;
+}
+
+// * * * * *
+//
+// Prgm::bcode(), Prgm::run()
+//
+// Compile the main script of a checked program into bytecode, and
+// run the program by executing that bytecode.
+//
+
+Bytc Prgm::bcode(void) const {
+    Bytc bc { main_symt };
+    main->bcode(bc);
+    bc.emit(BC_HALT);
+    return bc;
+}
+
+void Prgm::run(void) const {
+    Bytc bc = bcode();
+    bc.exec();
+}
+
+// * * * * *
+//
+// Blck::bcode(bc), Stmt::bcode(bc)
+//
+// Compile a block's statements into bytecode, appending it to `bc`.
+// Every statement starts with all temporaries free.
+//
+
+void Blck::bcode(Bytc& bc) const {
+    for (const Stmt_ptr& stmt : stmts) {
+        bc.free_temps();
+        stmt->bcode(bc);
+    }
+}
+
+void Ntro::bcode(Bytc& bc) const {
+    int reg = bc.intro(name,type);
+    expn->bcode(bc,reg);
+}
+
+void Asgn::bcode(Bytc& bc) const {
+    int reg = bc.slot(name,expn->type);
+    if (reg < 0) {
+        std::string msg = "Run-time error: variable '" + name + "' ";
+        msg += "not defined.";
+        throw DwislpyError { where(), msg };
+    }
+    expn->bcode(bc,reg);
+}
+
+void Pass::bcode([[maybe_unused]] Bytc& bc) const {
+    // does nothing!
+}
+
+void Prnt::bcode(Bytc& bc) const {
+    int reg = expn->bcode(bc,-1);
+    if (is_int(expn->type)) {
+        bc.emit(BC_PRTI,0,reg);
+    } else if (is_bool(expn->type)) {
+        bc.emit(BC_PRTB,0,reg);
+    } else if (is_str(expn->type)) {
+        bc.emit(BC_PRTS,0,reg);
+    } else {
+        bc.emit(BC_PRTN);
+    }
+}
+
+//
+// The main script shouldn't return but, as with `Blck::exec`, a
+// `return` there just ends the program.
+//
+void PRtn::bcode(Bytc& bc) const {
+    bc.emit(BC_HALT);
+}
+
+void FRtn::bcode(Bytc& bc) const {
+    expn->bcode(bc,-1);
+    bc.emit(BC_HALT);
+}
+
+// * * * * *
+//
+// Expn::bcode(bc,dest)
+//
+// Compile an expression into bytecode, appending it to `bc`, so that
+// its value ends up in the register `dest` of the register file for
+// its type. If `dest` is -1, the value can end up in any register.
+// Either way, the register holding the value is returned.
+//
+// The caller must not write to a register it gets back this way,
+// since it can be a variable's own slot (see `Lkup::bcode`).
+//
+
+int Plus::bcode(Bytc& bc, int dest) const {
+    int srce1 = left->bcode(bc,-1);
+    int srce2 = rght->bcode(bc,-1);
+    if (dest < 0) {
+        dest = bc.temp(type);
+    }
+    bc.emit(BC_IADD,dest,srce1,srce2);
+    return dest;
+}
+
+int Less::bcode(Bytc& bc, int dest) const {
+    int srce1 = left->bcode(bc,-1);
+    int srce2 = rght->bcode(bc,-1);
+    if (dest < 0) {
+        dest = bc.temp(type);
+    }
+    bc.emit(BC_ILSS,dest,srce1,srce2);
+    return dest;
+}
+
+//
+// The left operand is computed into a fresh temporary, rather than
+// `dest`, since `dest` might be a variable that the right operand
+// reads.
+//
+int And::bcode(Bytc& bc, int dest) const {
+    int temp = bc.temp(type);
+    left->bcode(bc,temp);
+    int jump = bc.emit(BC_JIFF,0,temp);
+    rght->bcode(bc,temp);
+    bc.patch(jump,bc.here());
+    if (dest < 0) {
+        return temp;
+    }
+    bc.emit(BC_IMOV,dest,temp);
+    return dest;
+}
+
+int Ltrl::bcode(Bytc& bc, int dest) const {
+    if (dest < 0) {
+        dest = bc.temp(type);
+    }
+    if (std::holds_alternative<int>(valu)) {
+        bc.emit(BC_ISET,dest,std::get<int>(valu));
+    } else if (std::holds_alternative<Strg>(valu)) {
+        bc.emit(BC_SSET,dest,bc.strg(std::get<Strg>(valu)));
+    } else if (std::holds_alternative<bool>(valu)) {
+        bc.emit(BC_ISET,dest,std::get<bool>(valu) ? 1 : 0);
+    } else {
+        bc.emit(BC_ISET,dest,0);
+    }
+    return dest;
+}
+
+int Lkup::bcode(Bytc& bc, int dest) const {
+    int reg = bc.slot(name,type);
+    if (reg < 0) {
+        std::string msg = "Run-time error: variable '" + name + "' ";
+        msg += "not defined.";
+        throw DwislpyError { where(), msg };
+    }
+    if (dest < 0 || dest == reg) {
+        return reg;
+    }
+    bc.emit(is_str(type) ? BC_SMOV : BC_IMOV,dest,reg);
+    return dest;
+}
+
+int Inpt::bcode(Bytc& bc, int dest) const {
+    int prompt = expn->bcode(bc,-1);
+    if (dest < 0) {
+        dest = bc.temp(type);
+    }
+    bc.emit(BC_INPT,dest,prompt);
+    return dest;
+}
+
+// * * * * *
+//
+// Bytc::exec()
+//
+// Runs the bytecode. Registers live in two flat arrays, one for each
+// kind of value, which are sized by the layout computed above.
+//
+void Bytc::exec(void) const {
+    std::vector<int> ints(int_size);
+    std::vector<std::string> strs(str_size);
+    const Bcod* pc = code.data();
+    for (;;) {
+        const Bcod& bc = *pc++;
+        switch (bc.op) {
+        case BC_ISET:
+            ints[bc.dst] = bc.src1;
+            break;
+        case BC_SSET:
+            strs[bc.dst] = strings[bc.src1];
+            break;
+        case BC_IMOV:
+            ints[bc.dst] = ints[bc.src1];
+            break;
+        case BC_SMOV:
+            strs[bc.dst] = strs[bc.src1];
+            break;
+        case BC_IADD:
+            ints[bc.dst] = ints[bc.src1] + ints[bc.src2];
+            break;
+        case BC_ILSS:
+            ints[bc.dst] = ints[bc.src1] < ints[bc.src2];
+            break;
+        case BC_JUMP:
+            pc = code.data() + bc.dst;
+            break;
+        case BC_JIFF:
+            if (!ints[bc.src1]) {
+                pc = code.data() + bc.dst;
+            }
+            break;
+        case BC_PRTI:
+            std::cout << ints[bc.src1] << '\n';
+            break;
+        case BC_PRTB:
+            std::cout << (ints[bc.src1] ? "True" : "False") << '\n';
+            break;
+        case BC_PRTS:
+            std::cout << strs[bc.src1] << '\n';
+            break;
+        case BC_PRTN:
+            std::cout << "None" << '\n';
+            break;
+        case BC_INPT:
+            //
+            // As with `Inpt::eval`, this version reads an int.
+            //
+            std::cout << strs[bc.src1];
+            std::cin >> ints[bc.dst];
+            break;
+        case BC_HALT:
+            std::cout.flush();
+            return;
+        }
+    }
+}
+
+// * * * * *
+//
+// Bytc::dump(os)
+//
+// Outputs a listing of the bytecode, one instruction per line.
+// Integer registers are shown as `i<n>` and string registers as
+// `s<n>`.
+//
+void Bytc::dump(std::ostream& os) const {
+    for (unsigned int i = 0; i < code.size(); i++) {
+        const Bcod& bc = code[i];
+        std::string ri = "i" + std::to_string(bc.src1);
+        std::string di = "i" + std::to_string(bc.dst);
+        os << i << "\t";
+        switch (bc.op) {
+        case BC_ISET: os << "iset " << di << "," << bc.src1; break;
+        case BC_SSET: os << "sset s" << bc.dst << ","
+                         << "\"" << re_escape(strings[bc.src1]) << "\"";
+                      break;
+        case BC_IMOV: os << "imov " << di << "," << ri; break;
+        case BC_SMOV: os << "smov s" << bc.dst << ",s" << bc.src1; break;
+        case BC_IADD: os << "iadd " << di << "," << ri
+                         << ",i" << bc.src2; break;
+        case BC_ILSS: os << "ilss " << di << "," << ri
+                         << ",i" << bc.src2; break;
+        case BC_JUMP: os << "jump " << bc.dst; break;
+        case BC_JIFF: os << "jiff " << bc.dst << "," << ri; break;
+        case BC_PRTI: os << "prti " << ri; break;
+        case BC_PRTB: os << "prtb " << ri; break;
+        case BC_PRTS: os << "prts s" << bc.src1; break;
+        case BC_PRTN: os << "prtn"; break;
+        case BC_INPT: os << "inpt " << di << ",s" << bc.src1; break;
+        case BC_HALT: os << "halt"; break;
+        }
+        os << std::endl;
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef _DWISLPY_BYTE_HH
+#define _DWISLPY_BYTE_HH
+
+//
+// dwislpy-byte.hh
+//
+// Objects used for running a checked DwiSlpy program with a bytecode
+// interpreter rather than by walking its AST.
+//
+// The tree-walking interpreter (`Prgm::walk`) keeps each variable in
+// a slot of a `Ctxt` frame but still dispatches on AST nodes and passes
+// `Valu` variants around by copy. Instead, `Prgm::run` compiles the
+// main script into a compact register-based bytecode where every
+// variable has been resolved to a fixed, typed slot, and then executes
+// that code with a simple dispatch loop.
+//
+// Because the program has been type checked, each slot holds values
+// of a single kind. An `int`, `bool`, or `None` value lives in the
+// integer register file (`bool` as 0/1, `None` as 0) and a `str` value
+// lives in the string register file. The opcodes are typed accordingly,
+// e.g. BC_IADD sums two integer registers.
+//
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+#include "dwislpy-check.hh"
+
+//
+// Opcd - the bytecode operations.
+//
+// Each operation is listed along with how it uses the `dst`, `src1`,
+// and `src2` fields of its `Bcod`. Below, `i[r]` is an integer register,
+// `s[r]` is a string register, and `k` is a constant.
+//
+//   BC_ISET d,k      - i[d] = k
+//   BC_SSET d,k      - s[d] = the k-th string constant
+//   BC_IMOV d,r      - i[d] = i[r]
+//   BC_SMOV d,r      - s[d] = s[r]
+//   BC_IADD d,r1,r2  - i[d] = i[r1] + i[r2]
+//   BC_ILSS d,r1,r2  - i[d] = i[r1] < i[r2]
+//   BC_JUMP t        - continue at code index t
+//   BC_JIFF t,r      - continue at code index t if i[r] is 0
+//   BC_PRTI r        - print i[r] as an `int`
+//   BC_PRTB r        - print i[r] as a `bool`
+//   BC_PRTS r        - print s[r]
+//   BC_PRTN          - print None
+//   BC_INPT d,r      - prompt with s[r], then read an `int` into i[d]
+//   BC_HALT          - stop running
+//
+enum Opcd : unsigned char {
+    BC_ISET, BC_SSET, BC_IMOV, BC_SMOV,
+    BC_IADD, BC_ILSS,
+    BC_JUMP, BC_JIFF,
+    BC_PRTI, BC_PRTB, BC_PRTS, BC_PRTN,
+    BC_INPT,
+    BC_HALT
+};
+
+//
+// class Bcod - a single bytecode instruction.
+//
+class Bcod {
+public:
+    Opcd op;
+    int dst;
+    int src1;
+    int src2;
+};
+
+typedef std::vector<Bcod> Bcod_vec;
+
+//
+// class Bytc
+//
+// The bytecode for a block of DwiSlpy code, along with the register
+// layout and the string constants it uses.
+//
+// A `Bytc` is built from the `SymT` that `chck` filled in for that
+// code. Each of its variables gets a slot in the register file that
+// matches its type. The AST nodes' `bcode` methods then append
+// instructions with `emit`, allocating registers for intermediate
+// results with `temp`. Temporaries are released with `free_temps`
+// between statements.
+//
+// Methods of Bytc:
+// ----------------
+//
+// * slot(nm,ty)  - the register holding variable `nm` of type `ty`.
+// * intro(nm,ty) - like `slot`, but gives a fresh register when
+//                  `nm` is introduced with a type other than the one
+//                  recorded in the symbol table.
+// * temp(ty)     - a fresh temporary register for a value of type `ty`.
+// * strg(s)      - index of the string constant `s`.
+// * emit(...)    - appends an instruction; gives its code index.
+// * here()       - the code index of the next instruction emitted.
+// * patch(j,t)   - sets the target of the jump at index `j` to `t`.
+// * exec()       - runs the code.
+// * dump(os)     - outputs a listing of the code.
+//
+class Bytc {
+public:
+    Bcod_vec code;
+    Bytc(const SymT& symt);
+    int slot(std::string nm, Type ty) const;
+    int intro(std::string nm, Type ty);
+    int temp(Type ty);
+    void free_temps(void);
+    int strg(Strg s);
+    int emit(Opcd op, int dst = 0, int src1 = 0, int src2 = 0);
+    int here(void) const { return code.size(); }
+    void patch(int jump, int target) { code[jump].dst = target; }
+    void exec(void) const;
+    void dump(std::ostream& os) const;
+private:
+    std::unordered_map<std::string, int> int_slots;
+    std::unordered_map<std::string, int> str_slots;
+    std::vector<std::string> strings;
+    std::unordered_map<Strg, int> string_index;
+    int int_vars = 0;      // Registers taken by variables.
+    int str_vars = 0;
+    int int_temps = 0;     // Registers taken by live temporaries.
+    int str_temps = 0;
+    int int_size = 0;      // Size of each register file.
+    int str_size = 0;
+};
+
+#endif
@@ -3,6 +3,8 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <optional>
 
 #include "dwislpy-check.hh"
 #include "dwislpy-ast.hh"
@@ -44,6 +46,54 @@ bool operator!=(Type type1, Type type2) {
     return !(type1 == type2);
 }
 
+//
+// The table of interned names. It is built on first use, so that
+// names can be interned at any time.
+//
+std::vector<std::string>& symb_names(void) {
+    static std::vector<std::string> names {""};
+    return names;
+}
+
+std::unordered_map<std::string,int>& symb_ids(void) {
+    static std::unordered_map<std::string,int> ids {{"",0}};
+    return ids;
+}
+
+int Symb::intern(const std::string& nm) {
+    std::unordered_map<std::string,int>& ids = symb_ids();
+    std::unordered_map<std::string,int>::iterator found = ids.find(nm);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    int id = symb_names().size();
+    symb_names().push_back(nm);
+    ids[nm] = id;
+    return id;
+}
+
+const std::string& Symb::name(void) const {
+    return symb_names()[id];
+}
+
+std::ostream& operator<<(std::ostream& os, Symb symb) {
+    return os << symb.name();
+}
+
+//
+// Strg::literal
+//
+// Gives the `Strg` for the literal text `s`, adding it to the pool if
+// it is new. The pool never frees its strings, so its `Strg`s share
+// them without owning them, and copying one does no reference counting.
+//
+Strg Strg::literal(const std::string& s) {
+    static std::unordered_set<std::string> pool { };
+    const std::string* text = &*pool.insert(s).first;
+    return Strg {std::shared_ptr<const std::string> {
+            std::shared_ptr<const std::string> {}, text}};
+}
+
 std::string type_name(Type type) {
     if (is_int(type)) {
         return "int";
@@ -182,6 +232,7 @@ Rtns Ntro::chck([[maybe_unused]] Rtns expd, Defs& defs, SymT& symt) {
         throw DwislpyError{where(), msg};
     }
     symt.add_locl(name,type);
+    slot = symt.get_info(name)->index;
     return Rtns{Void {}};
 }
 
@@ -190,6 +241,7 @@ Rtns Asgn::chck([[maybe_unused]] Rtns expd, Defs& defs, SymT& symt) {
         throw DwislpyError(where(), "Variable '" + name + "' never introduced.");
     }
     Type name_ty = symt.get_info(name)->type;
+    slot = symt.get_info(name)->index;
     Type expn_ty = expn->chck(defs,symt);
     if (name_ty != expn_ty) {
         std::string msg = "Type mismatch. Expected expression of type ";
@@ -281,7 +333,7 @@ Type And::chck(Defs& defs, SymT& symt) {
 Type Ltrl::chck([[maybe_unused]] Defs& defs, [[maybe_unused]] SymT& symt) {
     if (std::holds_alternative<int>(valu)) {
         type = Type {IntTy {}};
-    } else if (std::holds_alternative<std::string>(valu)) {
+    } else if (std::holds_alternative<Strg>(valu)) {
         type = Type {StrTy {}};
     } else if (std::holds_alternative<bool>(valu)) {
         type = Type {BoolTy {}};
@@ -294,6 +346,7 @@ Type Ltrl::chck([[maybe_unused]] Defs& defs, [[maybe_unused]] SymT& symt) {
 Type Lkup::chck([[maybe_unused]] Defs& defs, SymT& symt) {
     if (symt.has_info(name)) {
         type = symt.get_info(name)->type;
+        slot = symt.get_info(name)->index;
         return type;
     } else {
         throw DwislpyError {where(), "Unknown identifier."};
@@ -313,3 +366,146 @@ Type Inpt::chck(Defs& defs, SymT& symt) {
         throw DwislpyError { where(), msg };
     }
 }
+
+// * * * * *
+//
+// Constant folding.
+//
+// After checking, `Prgm::fold` rewrites each expression whose value
+// can be worked out from its literals into a literal of that value, so
+// that `trans` doesn't generate code to compute it. Along the way it
+// makes these simplifications:
+//
+//     e + 0, 0 + e                  =>  e
+//     True and e, e and True        =>  e
+//     False and e                   =>  False
+//     e and False                   =>  False, if evaluating e does
+//                                       nothing else (no `input`)
+//     x < x                         =>  False
+//
+// Sums that would overflow are left alone, since they trap at run time.
+//
+
+Expn_ptr literal(Valu valu, Type type, Locn lo) {
+    Ltrl_ptr ltrl { new Ltrl {valu,lo} };
+    ltrl->type = type;
+    return ltrl;
+}
+
+std::optional<Valu> value_of(Expn_ptr expn) {
+    if (Ltrl_ptr ltrl = dynamic_cast<Ltrl*>(expn)) {
+        return ltrl->valu;
+    }
+    return std::nullopt;
+}
+
+bool has_effects(Expn_ptr expn) {
+    if (dynamic_cast<Ltrl*>(expn) != nullptr
+        || dynamic_cast<Lkup*>(expn) != nullptr) {
+        return false;
+    }
+    if (Plus_ptr plus = dynamic_cast<Plus*>(expn)) {
+        return has_effects(plus->left) || has_effects(plus->rght);
+    }
+    if (Less_ptr less = dynamic_cast<Less*>(expn)) {
+        return has_effects(less->left) || has_effects(less->rght);
+    }
+    if (And_ptr conj = dynamic_cast<And*>(expn)) {
+        return has_effects(conj->left) || has_effects(conj->rght);
+    }
+    return true;
+}
+
+void Prgm::fold(void) {
+    for (std::pair<Name,Defn_ptr> dfpr : defs) {
+        dfpr.second->fold();
+    }
+    main->fold();
+}
+
+void Defn::fold(void) {
+    body->fold();
+}
+
+void Blck::fold(void) {
+    for (Stmt_ptr stmt : stmts) {
+        stmt->fold();
+    }
+}
+
+void Ntro::fold(void) {
+    expn = expn->fold();
+}
+
+void Asgn::fold(void) {
+    expn = expn->fold();
+}
+
+void Prnt::fold(void) {
+    expn = expn->fold();
+}
+
+void FRtn::fold(void) {
+    expn = expn->fold();
+}
+
+Expn_ptr Plus::fold(void) {
+    left = left->fold();
+    rght = rght->fold();
+    std::optional<Valu> lv = value_of(left);
+    std::optional<Valu> rv = value_of(rght);
+    if (lv.has_value() && rv.has_value()) {
+        long long sum = (long long)std::get<int>(*lv) + std::get<int>(*rv);
+        if (sum == (long long)(int)sum) {
+            return literal(Valu {(int)sum}, type, where());
+        }
+    }
+    if (lv.has_value() && std::get<int>(*lv) == 0) {
+        return rght;
+    }
+    if (rv.has_value() && std::get<int>(*rv) == 0) {
+        return left;
+    }
+    return this;
+}
+
+Expn_ptr Less::fold(void) {
+    left = left->fold();
+    rght = rght->fold();
+    std::optional<Valu> lv = value_of(left);
+    std::optional<Valu> rv = value_of(rght);
+    if (lv.has_value() && rv.has_value()) {
+        bool less = std::get<int>(*lv) < std::get<int>(*rv);
+        return literal(Valu {less}, type, where());
+    }
+    Lkup_ptr ll = dynamic_cast<Lkup*>(left);
+    Lkup_ptr rl = dynamic_cast<Lkup*>(rght);
+    if (ll != nullptr && rl != nullptr && ll->name == rl->name) {
+        return literal(Valu {false}, type, where());
+    }
+    return this;
+}
+
+Expn_ptr And::fold(void) {
+    left = left->fold();
+    rght = rght->fold();
+    std::optional<Valu> lv = value_of(left);
+    std::optional<Valu> rv = value_of(rght);
+    if (lv.has_value()) {
+        return std::get<bool>(*lv) ? rght : left;
+    }
+    if (rv.has_value()) {
+        if (std::get<bool>(*rv)) {
+            return left;
+        }
+        if (!has_effects(left)) {
+            return rght;
+        }
+    }
+    return this;
+}
+
+Expn_ptr Inpt::fold(void) {
+    expn = expn->fold();
+    return this;
+}
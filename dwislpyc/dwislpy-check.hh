@@ -4,7 +4,8 @@
 //
 // dwislpy-check.hh
 //
-// Defines `Type`, `Rtns`, and `SymT` used by the DWISLPY checking code.
+// Defines `Type`, `Rtns`, `Symb`, `Strg`, and `SymT` used by the DWISLPY
+// checking code.
 //
 // These are used to support type checking, return behavior checking,
 // and other semantic analysis of a parsed DWISLPY program.
@@ -44,6 +45,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <stdexcept>
 
 // * * * * *
 //
@@ -128,6 +130,79 @@ public:
 typedef std::variant<Void,VoidOr,Type> Rtns;
 
 
+// * * * * *
+//
+// Symb - the type of interned names.
+//
+// The names of variables, temporaries, and labels are each interned
+// once as a small integer `id`. The IR and the symbol tables refer to
+// names by their `Symb`, so that comparing, hashing, and looking them
+// up is just integer work. A `Symb` is made from a `std::string`
+// implicitly, and `name()` gives that string back.
+//
+// The empty name "" always has id 0, and is what a default `Symb` is.
+//
+
+class Symb {
+public:
+    int id;
+    Symb(void) : id {0} { }
+    Symb(const std::string& nm) : id {intern(nm)} { }
+    Symb(const char* nm) : id {intern(nm)} { }
+    const std::string& name(void) const;
+    bool operator==(Symb other) const { return id == other.id; }
+    bool operator!=(Symb other) const { return id != other.id; }
+    bool operator<(Symb other) const { return id < other.id; }
+private:
+    static int intern(const std::string& nm);
+};
+
+std::ostream& operator<<(std::ostream& os, Symb symb);
+
+namespace std {
+    template<> struct hash<Symb> {
+        size_t operator()(Symb symb) const { return symb.id; }
+    };
+}
+
+// * * * * *
+//
+// Strg - the type of string values.
+//
+// A `Strg` shares its text, so copying one never copies the text. The
+// text of a string literal is interned, with `Strg::literal`, in a pool
+// that lives for the whole run, and all the literals with the same
+// text share it. These are kept in the AST, and the compiler gives one
+// label per distinct text with `SymT::add_strg`.
+//
+// A string computed while running a program, e.g. by `Plus::eval`,
+// instead owns its text, which is freed when the last `Strg` holding
+// it goes away. Comparing and hashing go by the text.
+//
+
+class Strg {
+public:
+    explicit Strg(std::string&& s) :
+        text {std::make_shared<const std::string>(std::move(s))} { }
+    static Strg literal(const std::string& s);
+    const std::string& str(void) const { return *text; }
+    bool operator==(const Strg& other) const {
+        return text == other.text || *text == *other.text;
+    }
+    bool operator!=(const Strg& other) const { return !(*this == other); }
+private:
+    explicit Strg(std::shared_ptr<const std::string> t) : text {t} { }
+    std::shared_ptr<const std::string> text;
+};
+
+namespace std {
+    template<> struct hash<Strg> {
+        size_t operator()(const Strg& strg) const {
+            return std::hash<std::string> {}(strg.str());
+        }
+    };
+}
+
 // * * * * *
 // 
 // SymInfo - the type of symbol tables used by our semantic analysis.
@@ -152,6 +227,9 @@ typedef std::variant<Void,VoidOr,Type> Rtns;
 // introduced x within the body) we provide support for distinguishing variables
 // by an integer index `identifier`.
 //
+// Variables are looked up by their `Symb`. The symbol table keeps its
+// entries in a vector indexed by the `Symb`'s id.
+//
 // You can add variables to symbol table using `add_frml`, `add_locl`, `add_temp`.
 // You can check the symbol table with `has_info`.
 // You can get a variable's information with `get_info`.
@@ -165,6 +243,22 @@ typedef std::variant<Void,VoidOr,Type> Rtns;
 // 3rd, etc parameter's information. The method `get_frmls_size` tells you
 // how many formal parameters are stored in a symbol table.
 //
+// For code generation, register allocation can place a variable in a
+// MIPS register rather than the stack frame. This is recorded with
+// `set_register`. The callee-saved registers that a function uses (and
+// so must save and restore) are recorded with `add_saved`. The others
+// are numbered with `set_frame_slot`, where variables whose lifetimes
+// don't overlap can share a slot. The resulting frame size, and the
+// size it would have been with one slot per variable, are reported by
+// `get_frame_size` and `get_unshared_frame_size`. A function that makes
+// no calls is marked with `set_leaf`, and may need no frame at all, in
+// which case its frame size is 0.
+//
+// The program's `.data` entries are kept by the global table. Each
+// distinct string constant gets one label from `add_strg`, no matter
+// how many times it is added, whereas `add_data` always gives a fresh
+// entry (e.g. for the input buffer, which gets written over).
+//
 
 enum SymKind { FRML, LOCL, TEMP };
 
@@ -178,8 +272,12 @@ public:
     Type type;
     SymKind kind;
     int frame_offset;
+    std::string reg; // MIPS register it's kept in, or "" if in the frame.
+    int frame_slot;  // Frame slot it's kept in, or -1 if it needs none.
+    int index;       // Its place in an interpreter frame (see `Ctxt`).
     SymInfo(std::string nm, Type ty, int id, SymKind kd) :
-        name {nm}, identifier {id}, type {ty}, kind {kd} {}
+        name {nm}, identifier {id}, type {ty}, kind {kd},
+        reg {""}, frame_slot {-1}, index {-1} {}
 };
 
 class SymT;
@@ -192,26 +290,26 @@ typedef std::shared_ptr<SymT> SymT_ptr;
 class SymT {
 public:
     std::unordered_map<std::string, std::string> strings;
-    SymT() : sym_table {}, formals {}, globals {nullptr} { }
+    SymT() : by_symb {}, formals {}, globals {nullptr} { }
     std::string add_frml(std::string nm, Type ty) {
-        sym_table[nm] = SymInfo_ptr{ new SymInfo {nm, ty, 0, FRML} };
+        put(nm, SymInfo_ptr{ new SymInfo {nm, ty, 0, FRML} });
         formals.push_back(nm);
         return nm;
     }
     std::string add_locl(std::string nm, Type ty) {
-        sym_table[nm] = SymInfo_ptr{ new SymInfo {nm, ty, sym_id++, LOCL} };
+        put(nm, SymInfo_ptr{ new SymInfo {nm, ty, sym_id++, LOCL} });
         locals.push_back(nm);
         return nm;
     }
     std::string add_temp(std::string nm, Type ty) {
-        sym_table[nm] = SymInfo_ptr{ new SymInfo {nm, ty, sym_id++, TEMP} };
+        put(nm, SymInfo_ptr{ new SymInfo {nm, ty, sym_id++, TEMP} });
         locals.push_back(nm);
         return nm;
     }
     std::string add_temp(Type ty) {
         int id = sym_id++;
         std::string nm = "temp_" + std::to_string(id);
-        sym_table[nm] = SymInfo_ptr{ new SymInfo {nm, ty, id, TEMP} };
+        put(nm, SymInfo_ptr{ new SymInfo {nm, ty, id, TEMP} });
         locals.push_back(nm);
         return nm;
     }
@@ -234,26 +332,39 @@ public:
             return globals->add_labl();
         }
     }
-    std::string add_strg(std::string strg) {
+    std::string add_strg(Strg strg) {
+        if (globals == nullptr) {
+            if (strg_lbls.count(strg) == 0) {
+                strg_lbls.emplace(strg, add_data(strg.str()));
+            }
+            return strg_lbls.at(strg);
+        } else {
+            return globals->add_strg(strg);
+        }
+    }
+    std::string add_data(std::string data) {
         if (globals == nullptr) {
             std::string labl = this->add_labl();
-            strings[labl] = strg;
+            strings[labl] = data;
             return labl;
         } else {
-            return globals->add_strg(strg);
+            return globals->add_data(data);
         }
     }
-    bool has_info(std::string nm) const {
-        return (sym_table.count(nm) > 0);
+    bool has_info(Symb nm) const {
+        return nm.id < (int)by_symb.size() && by_symb[nm.id] != nullptr;
     }
-    SymInfo_ptr get_info(std::string nm) const {
-        return sym_table.at(nm);
+    SymInfo_ptr get_info(Symb nm) const {
+        if (!has_info(nm)) {
+            throw std::out_of_range {"no symbol " + nm.name()};
+        }
+        return by_symb[nm.id];
     }
     SymInfo_ptr get_locl(int i) const {
-        return sym_table.at(locals[i]);
+        return by_symb[locals[i].id];
     }
     SymInfo_ptr get_frml(int i) const {
-        return sym_table.at(formals[i]);
+        return by_symb[formals[i].id];
     }
     unsigned int get_frmls_size(void) const {
         return formals.size();
@@ -261,10 +372,10 @@ public:
     unsigned int get_locls_size(void) const {
         return locals.size();
     }
-    void set_frame_offset(std::string nm, int offset) {
+    void set_frame_offset(Symb nm, int offset) {
         get_info(nm)->frame_offset = offset;
     }
-    int get_frame_offset(std::string nm) const {
+    int get_frame_offset(Symb nm) const {
         return get_info(nm)->frame_offset;
     }
     void set_frame_size(int sz) {
@@ -273,13 +384,57 @@ public:
     int get_frame_size(void) const {
         return frame_size;
     }
+    void set_unshared_frame_size(int sz) {
+        unshared_frame_size = sz;
+    }
+    int get_unshared_frame_size(void) const {
+        return unshared_frame_size;
+    }
+    void set_frame_slot(Symb nm, int slot) {
+        get_info(nm)->frame_slot = slot;
+    }
+    int get_frame_slot(Symb nm) const {
+        return get_info(nm)->frame_slot;
+    }
+    void set_register(Symb nm, std::string reg) {
+        get_info(nm)->reg = reg;
+    }
+    std::string get_register(Symb nm) const {
+        return get_info(nm)->reg;
+    }
+    bool has_register(Symb nm) const {
+        return get_info(nm)->reg != "";
+    }
+    void add_saved(std::string reg) {
+        saved.push_back(reg);
+    }
+    const std::vector<std::string>& get_saved(void) const {
+        return saved;
+    }
+    void set_leaf(bool lf) {
+        leaf = lf;
+    }
+    bool is_leaf(void) const {
+        return leaf;
+    }
 private:
-    std::unordered_map<std::string, SymInfo_ptr> sym_table;
-    std::vector<std::string> formals;
-    std::vector<std::string> locals;
+    void put(Symb nm, SymInfo_ptr info) {
+        info->index = formals.size() + locals.size();
+        if (nm.id >= (int)by_symb.size()) {
+            by_symb.resize(nm.id + 1);
+        }
+        by_symb[nm.id] = info;
+    }
+    std::vector<SymInfo_ptr> by_symb; // Indexed by `Symb` id.
+    std::vector<Symb> formals;
+    std::vector<Symb> locals;
     SymT_ptr globals;
+    std::vector<std::string> saved; // Callee-saved registers used.
+    bool leaf = false;              // Whether its code makes no calls.
+    std::unordered_map<Strg,std::string> strg_lbls; // Label of each string.
     int sym_id = 0;
     int frame_size;
+    int unshared_frame_size; // Frame size had no slots been shared.
 };
 
 
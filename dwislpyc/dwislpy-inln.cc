@@ -0,0 +1,322 @@
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <optional>
+
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+#include "dwislpy-ast.hh"
+#include "dwislpy-regs.hh"
+#include "dwislpy-inln.hh"
+
+//
+// dwislpy-inln.cc
+//
+// This gives the inliner described in `dwislpy-inln.hh`.
+//
+// Its heuristic weighs the size of a `def`'s body against what a call
+// to it costs. A call takes an `ARG` for each argument, a `CLL`, and
+// an `RTV`, and the `ENTER` and `LEAVE` of the called code each
+// become several MIPS instructions that save and restore `$ra` and
+// `$fp`. A body that is no bigger than that, give or take
+// `INLINE_SIZE` instructions, is worth copying in. Since inlining
+// never adds calls, the calls inside a `def` can be inlined first to
+// make it small and call-free enough to be inlined itself.
+//
+
+const int INLINE_SIZE = 8;
+const int INLINE_GROWTH = 4;
+
+//
+// body_size(code)
+//
+// The number of instructions of a `def`'s code that would be copied
+// into a caller and that do any work.
+//
+int body_size(const INST_vec& code) {
+    int size = 0;
+    for (INST_ptr inst : code) {
+        if (dynamic_cast<LBL*>(inst) == nullptr
+            && dynamic_cast<CMT*>(inst) == nullptr
+            && dynamic_cast<NOP*>(inst) == nullptr
+            && dynamic_cast<ENTER*>(inst) == nullptr
+            && dynamic_cast<LEAVE*>(inst) == nullptr) {
+            size++;
+        }
+    }
+    return size;
+}
+
+//
+// worth_inlining(defn)
+//
+bool worth_inlining(const Defn& defn) {
+    int call_cost = defn.arity() + 2;
+    return is_leaf(defn.code)
+        && body_size(defn.code) <= call_cost + INLINE_SIZE;
+}
+
+//
+// call_args(code,at,arity,args)
+//
+// Collect the arguments of a call made just before index `at` of
+// `code` into `args`, from the run of `ARG`s that precede it. This
+// gives the number of `ARG`s. If there aren't `arity` of them, giving
+// each argument just once, then `args` is left empty.
+//
+unsigned int call_args(const INST_vec& code, unsigned int at,
+                       unsigned int arity, std::vector<Symb>& args) {
+    std::vector<std::optional<Symb>> found (arity);
+    unsigned int num_args = 0;
+    while (num_args < arity && num_args < at) {
+        ARG* arg = dynamic_cast<ARG*>(code[at-1-num_args]);
+        if (arg == nullptr) {
+            break;
+        }
+        if (arg->idx >= 0 && arg->idx < (int)arity) {
+            found[arg->idx] = arg->src;
+        }
+        num_args++;
+    }
+    args.clear();
+    for (std::optional<Symb> arg : found) {
+        if (!arg.has_value()) {
+            args.clear();
+            break;
+        }
+        args.push_back(*arg);
+    }
+    return num_args;
+}
+
+//
+// inline_body(symt,callee,args,dst,code)
+//
+// Put a copy of the code of `callee` into `code`, as called with the
+// arguments `args` and, if it is given, with its result going to
+// `dst`. Its variables and labels are renamed to fresh ones of `symt`.
+//
+void inline_body(SymT& symt, const Defn& callee,
+                 const std::vector<Symb>& args, std::optional<Symb> dst,
+                 INST_vec& code) {
+
+    // Give each of the callee's variables a fresh temporary.
+    //
+    std::unordered_map<Symb,Symb> var_for { };
+    auto rename_var = [&](Symb nm) {
+        if (!callee.symt.has_info(nm)) {
+            return nm;
+        }
+        if (var_for.count(nm) == 0) {
+            Type ty = callee.symt.get_info(nm)->type;
+            var_for[nm] = Symb {symt.add_temp(ty)};
+        }
+        return var_for.at(nm);
+    };
+
+    // Give each of the labels it defines a fresh label. Its entry label
+    // is dropped, since it's not recursive and so nothing jumps to it.
+    //
+    Symb entry { callee.name };
+    std::unordered_map<Symb,Symb> lbl_for { };
+    for (INST_ptr inst : callee.code) {
+        if (LBL* lbl = dynamic_cast<LBL*>(inst)) {
+            if (lbl->lbl != entry) {
+                lbl_for[lbl->lbl] = Symb {symt.add_labl()};
+            }
+        }
+    }
+    auto rename_lbl = [&](Symb lbl) {
+        return lbl_for.count(lbl) > 0 ? lbl_for.at(lbl) : lbl;
+    };
+
+    // Set the formals to the arguments.
+    //
+    code.push_back(INST_ptr {new CMT {"inlined " + callee.name}});
+    for (unsigned int i = 0; i < args.size(); i++) {
+        Symb frml { callee.formal(i)->name };
+        code.push_back(INST_ptr {new MOV {rename_var(frml), args[i]}});
+    }
+
+    // Copy the body, with `RTN` handing the result to `dst`.
+    //
+    for (INST_ptr inst : callee.code) {
+        if (dynamic_cast<ENTER*>(inst) != nullptr
+            || dynamic_cast<LEAVE*>(inst) != nullptr) {
+            continue;
+        }
+        if (LBL* lbl = dynamic_cast<LBL*>(inst)) {
+            if (lbl->lbl != entry) {
+                code.push_back(INST_ptr {new LBL {rename_lbl(lbl->lbl)}});
+            }
+            continue;
+        }
+        if (RTN* rtn = dynamic_cast<RTN*>(inst)) {
+            if (dst.has_value()) {
+                code.push_back(INST_ptr {new MOV {*dst, rename_var(rtn->src)}});
+            }
+            continue;
+        }
+        INST_ptr copy = inst->clone();
+        std::vector<Symb> srcs { };
+        for (Symb src : inst->srcs()) {
+            srcs.push_back(rename_var(src));
+        }
+        std::vector<Symb> dsts { };
+        for (Symb dst : inst->dsts()) {
+            dsts.push_back(rename_var(dst));
+        }
+        std::vector<Symb> lbls { };
+        for (Symb lbl : inst->targets()) {
+            lbls.push_back(rename_lbl(lbl));
+        }
+        copy->set_srcs(srcs);
+        copy->set_dsts(dsts);
+        copy->set_targets(lbls);
+        code.push_back(copy);
+    }
+}
+
+//
+// inline_calls(defs,symt,code)
+//
+// Walk through `code` looking for a `CLL` of a `def` worth inlining.
+// Its arguments are given by the run of `ARG`s just before it, and
+// its result is taken by an `RTV` just after it, if there is one.
+// These are all replaced by a copy of the `def`'s code.
+//
+bool inline_calls(const Defs& defs, SymT& symt, INST_vec& code) {
+    unsigned int limit = INLINE_GROWTH * code.size();
+    bool changed = false;
+    INST_vec inlined { };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        CLL* cll = dynamic_cast<CLL*>(code[i]);
+        if (cll == nullptr || defs.count(cll->lbl.name()) == 0) {
+            inlined.push_back(code[i]);
+            continue;
+        }
+        Defn_ptr callee = defs.at(cll->lbl.name());
+        unsigned int size = inlined.size() + (code.size() - i)
+                          + body_size(callee->code);
+        if (!worth_inlining(*callee) || size > limit) {
+            inlined.push_back(code[i]);
+            continue;
+        }
+
+        // Find the arguments of the call among the `ARG`s before it.
+        //
+        std::vector<Symb> args { };
+        unsigned int num_args = call_args(inlined, inlined.size(),
+                                          callee->arity(), args);
+        if (args.size() != callee->arity()) {
+            inlined.push_back(code[i]);
+            continue;
+        }
+
+        // Find where its result goes.
+        //
+        std::optional<Symb> dst { };
+        if (i+1 < code.size()) {
+            if (RTV* rtv = dynamic_cast<RTV*>(code[i+1])) {
+                dst = rtv->dst;
+                i++;
+            }
+        }
+
+        inlined.resize(inlined.size() - num_args);
+        inline_body(symt, *callee, args, dst, inlined);
+        changed = true;
+    }
+    code = inlined;
+    return changed;
+}
+
+//
+// eliminate_tail_calls(defn)
+//
+// Look for the code `FRtn::trans` makes for returning the result of a
+// call of the `def` itself, namely
+//
+//     ARG 0,a0 ... ARG n-1,an-1; CLL f; RTV t; RTN t; JMP f_done
+//
+// and replace it with
+//
+//     MOV t0,a0 ... MOV tn-1,an-1; MOV x0,t0 ... MOV xn-1,tn-1; JMP f_top
+//
+// where `x0`...`xn-1` are its formals and `f_top` labels its code just
+// after the `ENTER`. The arguments go through fresh temporaries so
+// that a formal is not overwritten before it is used by another
+// argument.
+//
+bool eliminate_tail_calls(Defn& defn) {
+    SymT& symt = defn.symt;
+    INST_vec& code = defn.code;
+    Symb entry { defn.name };
+
+    // Find the label that returns jump to, the one just before `LEAVE`.
+    //
+    std::optional<Symb> exit { };
+    for (unsigned int i = 0; i+1 < code.size(); i++) {
+        LBL* lbl = dynamic_cast<LBL*>(code[i]);
+        if (lbl != nullptr && dynamic_cast<LEAVE*>(code[i+1]) != nullptr) {
+            exit = lbl->lbl;
+        }
+    }
+    if (!exit.has_value()) {
+        return false;
+    }
+
+    Symb top { symt.add_labl(defn.name+"_top") };
+    bool changed = false;
+    INST_vec looped { };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        looped.push_back(code[i]);
+        if (dynamic_cast<ENTER*>(code[i]) != nullptr) {
+            looped.push_back(INST_ptr {new LBL {top}});
+            continue;
+        }
+
+        // Check for a self call whose result is returned.
+        //
+        CLL* cll = dynamic_cast<CLL*>(code[i]);
+        if (cll == nullptr || cll->lbl != entry || i+3 >= code.size()) {
+            continue;
+        }
+        RTV* rtv = dynamic_cast<RTV*>(code[i+1]);
+        RTN* rtn = dynamic_cast<RTN*>(code[i+2]);
+        JMP* jmp = dynamic_cast<JMP*>(code[i+3]);
+        if (rtv == nullptr || rtn == nullptr || jmp == nullptr
+            || rtn->src != rtv->dst || jmp->lbl != *exit) {
+            continue;
+        }
+        looped.pop_back();
+        std::vector<Symb> args { };
+        unsigned int num_args = call_args(looped, looped.size(),
+                                          defn.arity(), args);
+        if (args.size() != defn.arity()) {
+            looped.push_back(code[i]);
+            continue;
+        }
+
+        // Reassign the formals and jump back to the top.
+        //
+        looped.resize(looped.size() - num_args);
+        std::vector<Symb> temps { };
+        for (unsigned int a = 0; a < args.size(); a++) {
+            Symb temp { symt.add_temp(defn.formal(a)->type) };
+            looped.push_back(INST_ptr {new MOV {temp, args[a]}});
+            temps.push_back(temp);
+        }
+        for (unsigned int a = 0; a < args.size(); a++) {
+            Symb frml { defn.formal(a)->name };
+            looped.push_back(INST_ptr {new MOV {frml, temps[a]}});
+        }
+        looped.push_back(INST_ptr {new JMP {top}});
+        i += 3;
+        changed = true;
+    }
+    if (changed) {
+        code = looped;
+    }
+    return changed;
+}
@@ -0,0 +1,54 @@
+#ifndef _DWISLPY_INLN_HH
+#define _DWISLPY_INLN_HH
+
+//
+// dwislpy-inln.hh
+//
+// An inliner for the IR of a DwiSlpy program.
+//
+// A call to a `def` sets up its arguments with `ARG`, jumps to its
+// code with `CLL`, and gets its result with `RTV`, and the called
+// code builds and tears down a whole stack frame with `ENTER` and
+// `LEAVE`. For a small `def` this overhead can cost more than its body
+// does. The inliner replaces such calls with a copy of the called
+// `def`'s IR, so that the optimizer of `dwislpy-opt.hh` can then work
+// on the caller and the copied body together.
+//
+// A `def` that returns the result of calling itself is turned into a
+// loop instead, so that its recursion takes no stack.
+//
+// These run after `Prgm::trans` and before `optimize`.
+//
+
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+#include "dwislpy-ast.hh"
+
+//
+// inline_calls(defs,symt,code)
+//
+// Replace the calls made by `code` to small `def`s of `defs` with
+// copies of their code. The copied variables and labels are renamed
+// to fresh temporaries and labels of `symt`, the formals are set to
+// the arguments with `MOV`, and each `RTN` becomes a `MOV` to where
+// the call's `RTV` put the result.
+//
+// A `def` is inlined if it makes no calls itself (and so is not
+// recursive) and its body has no more instructions than a call to it
+// costs plus `INLINE_SIZE` (see `dwislpy-inln.cc`). The code is not
+// allowed to grow past `INLINE_GROWTH` times its size at the start.
+// This reports whether any calls were inlined.
+//
+bool inline_calls(const Defs& defs, SymT& symt, INST_vec& code);
+
+//
+// eliminate_tail_calls(defn)
+//
+// Replace each call that `defn` makes to itself and whose result it
+// returns right away with a reassignment of its formals to the call's
+// arguments and a jump back to the start of its code. This reports
+// whether any calls were replaced.
+//
+bool eliminate_tail_calls(Defn& defn);
+
+#endif
@@ -10,6 +10,17 @@
 // `dwislpy-inst.hh`.
 //
 
+//
+// INST::operator new(size)
+//
+// Hand out the memory for an instruction from the IR's arena, so that
+// the instructions for a function end up next to each other in memory.
+//
+void* INST::operator new(std::size_t size) {
+    static Arena arena { };
+    return arena.allocate(size);
+}
+
 //
 // These are global variables for the top-level labels used for
 // the string constants needed for the translation. They are set
@@ -35,11 +46,11 @@ void Prgm::trans(void) {
 
     // Create labels for the global string constants needed.
     //
-    EOLN_STRG_LBL = glbl_symt_ptr->add_strg("\n");
-    TRUE_STRG_LBL = glbl_symt_ptr->add_strg("True");
-    FLSE_STRG_LBL = glbl_symt_ptr->add_strg("False");
-    NONE_STRG_LBL = glbl_symt_ptr->add_strg("None");
-    INPT_BUFF_LBL = glbl_symt_ptr->add_strg("12345678901234567890123456789012345678901234567890123456789012345678901234567890");
+    EOLN_STRG_LBL = glbl_symt_ptr->add_strg(Strg::literal("\n"));
+    TRUE_STRG_LBL = glbl_symt_ptr->add_strg(Strg::literal("True"));
+    FLSE_STRG_LBL = glbl_symt_ptr->add_strg(Strg::literal("False"));
+    NONE_STRG_LBL = glbl_symt_ptr->add_strg(Strg::literal("None"));
+    INPT_BUFF_LBL = glbl_symt_ptr->add_data("12345678901234567890123456789012345678901234567890123456789012345678901234567890");
 
     // Translate each definition into IR.
     //
@@ -205,68 +216,6 @@ void Plus::trans(std::string dest, SymT& symt, INST_vec& code) {
     }
 }
 
-void Mnus::trans(std::string dest, SymT& symt, INST_vec& code) {
-    if (std::holds_alternative<IntTy>(type)) {
-        std::string srce1 = symt.add_temp(left->type);
-        std::string srce2 = symt.add_temp(rght->type);
-        left->trans(srce1,symt,code);
-        rght->trans(srce2,symt,code);
-        code.push_back(INST_ptr {new SUB {dest,srce1,srce2}});
-    }
-}
-
-void Tmes::trans(std::string dest, SymT& symt, INST_vec& code) {
-    if (std::holds_alternative<IntTy>(type)) {
-        std::string srce1 = symt.add_temp(left->type);
-        std::string srce2 = symt.add_temp(rght->type);
-        left->trans(srce1,symt,code);
-        rght->trans(srce2,symt,code);
-        code.push_back(INST_ptr {new ADD {dest,0,srce1*srce2}});
-    }
-}
-
-void PlEq::trans([[maybe_unused]]std::string exit,
-                 SymT& symt, INST_vec& code) {
-    expn->trans(name,symt,code);
-}
-
-void MnEq::trans([[maybe_unused]]std::string exit,
-                 SymT& symt, INST_vec& code) {
-    expn->trans(name,symt,code);
-}
-
-void TmEq::trans([[maybe_unused]]std::string exit,
-                 SymT& symt, INST_vec& code) {
-    expn->trans(name,symt,code);
-}
-
-void Whle::trans(std::string dest, SymT& symt, INST_vec& code) {
-    std::string true_lbl = symt.add_labl();
-    std::string flse_lbl = symt.add_labl();
-    std::string done_lbl = symt.add_labl();
-    trans_cndn(true_lbl,flse_lbl,symt,code);
-    code.push_back(INST_ptr {new LBL {true_lbl}});
-    code.push_back(INST_ptr {new SET {dest,1}});
-    code.push_back(INST_ptr {new JMP {done_lbl}});
-    code.push_back(INST_ptr {new LBL {flse_lbl}});
-    code.push_back(INST_ptr {new SET {dest,0}});
-    code.push_back(INST_ptr {new LBL {done_lbl}});
-}
-
-void IfEl::trans(std::string dest, SymT& symt, INST_vec& code) {
-    std::string true_lbl = symt.add_labl();
-    std::string flse_lbl = symt.add_labl();
-    std::string done_lbl = symt.add_labl();
-    trans_cndn(true_lbl,flse_lbl,symt,code);
-    code.push_back(INST_ptr {new LBL {true_lbl}});
-    code.push_back(INST_ptr {new SET {dest,1}});
-    code.push_back(INST_ptr {new JMP {done_lbl}});
-    code.push_back(INST_ptr {new LBL {flse_lbl}});
-    code.push_back(INST_ptr {new SET {dest,0}});
-    code.push_back(INST_ptr {new LBL {done_lbl}});
-}
-
-
 void Expn::trans_cndn([[maybe_unused]]std::string then_lbl,
                       [[maybe_unused]]std::string else_lbl,
                       [[maybe_unused]]SymT& symt,
@@ -277,75 +226,6 @@ void Expn::trans_cndn([[maybe_unused]]std::string then_lbl,
 
 }
 
-void LsEq::trans(std::string dest, SymT& symt, INST_vec& code) {
-    std::string true_lbl = symt.add_labl();
-    std::string flse_lbl = symt.add_labl();
-    std::string done_lbl = symt.add_labl();
-    trans_cndn(true_lbl,flse_lbl,symt,code);
-    code.push_back(INST_ptr {new LBL {true_lbl}});
-    code.push_back(INST_ptr {new SET {dest,1}});
-    code.push_back(INST_ptr {new JMP {done_lbl}});
-    code.push_back(INST_ptr {new LBL {flse_lbl}});
-    code.push_back(INST_ptr {new SET {dest,0}});
-    code.push_back(INST_ptr {new LBL {done_lbl}});
-}
-
-void Not::trans_cndn(std::string then_lbl, std::string else_lbl,
-                     SymT& symt, INST_vec& code) {
-	std::string cont_lbl = symt.add_labl();
-	left->trans_cndn(cont_lbl,else_lbl,symt,code);
-	code.push_back(INST_ptr {new LBL {cont_lbl}});
-	rght->trans_cndn(then_lbl,else_lbl,symt,code);
-}
-
-void Not::trans(std::string dest, SymT& symt, INST_vec& code) {
-	std::string true_lbl = symt.add_labl();
-	std::string flse_lbl = symt.add_labl();
-	std::string done_lbl = symt.add_labl();
-	trans_cndn(true_lbl,flse_lbl,symt,code);
-	code.push_back(INST_ptr {new LBL {true_lbl}});
-	code.push_back(INST_ptr {new SET {dest,1}});
-	code.push_back(INST_ptr {new JMP {done_lbl}});
-	code.push_back(INST_ptr {new LBL {flse_lbl}});
-	code.push_back(INST_ptr {new SET {dest,0}});
-	code.push_back(INST_ptr {new LBL {done_lbl}});
-}
-
-
-void Or::trans_cndn(std::string then_lbl, std::string else_lbl,
-                     SymT& symt, INST_vec& code) {
-	std::string cont_lbl = symt.add_labl();
-	left->trans_cndn(cont_lbl,else_lbl,symt,code);
-	code.push_back(INST_ptr {new LBL {cont_lbl}});
-	rght->trans_cndn(then_lbl,else_lbl,symt,code);
-}
-
-void Or::trans(std::string dest, SymT& symt, INST_vec& code) {
-	std::string true_lbl = symt.add_labl();
-	std::string flse_lbl = symt.add_labl();
-	std::string done_lbl = symt.add_labl();
-	trans_cndn(true_lbl,flse_lbl,symt,code);
-	code.push_back(INST_ptr {new LBL {true_lbl}});
-	code.push_back(INST_ptr {new SET {dest,1}});
-	code.push_back(INST_ptr {new JMP {done_lbl}});
-	code.push_back(INST_ptr {new LBL {flse_lbl}});
-	code.push_back(INST_ptr {new SET {dest,0}});
-	code.push_back(INST_ptr {new LBL {done_lbl}});
-}
-
-void Equl::trans(std::string dest, SymT& symt, INST_vec& code) {
-    std::string true_lbl = symt.add_labl();
-    std::string flse_lbl = symt.add_labl();
-    std::string done_lbl = symt.add_labl();
-    trans_cndn(true_lbl,flse_lbl,symt,code);
-    code.push_back(INST_ptr {new LBL {true_lbl}});
-    code.push_back(INST_ptr {new SET {dest,1}});
-    code.push_back(INST_ptr {new JMP {done_lbl}});
-    code.push_back(INST_ptr {new LBL {flse_lbl}});
-    code.push_back(INST_ptr {new SET {dest,0}});
-    code.push_back(INST_ptr {new LBL {done_lbl}});
-}
-
 void Less::trans_cndn(std::string then_lbl, std::string else_lbl,
                       SymT& symt, INST_vec& code) {
     if (std::holds_alternative<IntTy>(left->type)
@@ -373,8 +253,6 @@ void Less::trans(std::string dest, SymT& symt, INST_vec& code) {
     code.push_back(INST_ptr {new LBL {done_lbl}});
 }
 
-
-
 void And::trans_cndn(std::string then_lbl, std::string else_lbl,
                      SymT& symt, INST_vec& code) {
     std::string cont_lbl = symt.add_labl();
@@ -401,9 +279,8 @@ void Ltrl::trans(std::string dest, SymT& symt, INST_vec& code) {
         int ival = std::get<int>(valu);
         code.push_back(INST_ptr {new SET {dest,ival}});
     }
-    if (std::holds_alternative<std::string>(valu)) {
-        std::string sval = std::get<std::string>(valu);
-        std::string strg_lbl = symt.add_strg(sval);
+    if (std::holds_alternative<Strg>(valu)) {
+        std::string strg_lbl = symt.add_strg(std::get<Strg>(valu));
         code.push_back(INST_ptr {new STL {dest,strg_lbl}});
     }
     if (std::holds_alternative<bool>(valu)) {
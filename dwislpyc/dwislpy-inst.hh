@@ -14,10 +14,11 @@
 #include <utility>
 #include <string>
 #include <memory>
+#include <cstddef>
 #include "dwislpy-check.hh"
 
 class INST;
-typedef std::shared_ptr<INST> INST_ptr;
+typedef INST* INST_ptr;
 typedef std::vector<INST_ptr> INST_vec;
 
 //
@@ -61,14 +62,52 @@ typedef std::vector<INST_ptr> INST_vec;
 // frame locations of each variable and temporary. It also tracks
 // whole-program information like string constants.
 //
+// The remaining methods describe how a pseudo-instruction uses
+// variables and affects control flow. They are used for analyses of
+// the IR, like the liveness analysis that drives register allocation
+// in `dwislpy-regs.cc`.
+//
+// * srcs    - the variables and temporaries that it reads.
+// * dsts    - the variables and temporaries that it writes.
+// * targets - the labels that it might jump to.
+// * falls   - whether execution can continue with the next instruction.
+// * calls   - whether it calls a function, clobbering the registers
+//             that are not preserved across calls.
+//
+// The first three each have a `set_` counterpart taking a vector in the
+// same order, used by the optimizer in `dwislpy-opt.cc` to rewrite an
+// instruction's operands.
+//
+// * clone   - a copy of the instruction, used by the inliner in
+//             `dwislpy-inln.cc` so that a copy's operands can be
+//             rewritten without touching the original.
+//
+// Operands that name variables, temporaries, or labels are held as
+// interned `Symb`s (see `dwislpy-check.hh`). They can be given as
+// `std::string`s when constructing an instruction.
+//
+// Instructions are allocated from an arena with `new` (see `INST::operator
+// new` in `dwislpy-inst.cc`), and they live until the compiler exits.
+// So an `INST_ptr` is a plain pointer, and an `INST_vec` is a vector of
+// them. They are never deleted.
+//
 
 class INST {
 public:
+  static void* operator new(std::size_t size);
+  static void operator delete([[maybe_unused]] void* inst) { }
   virtual void toMIPS(std::ostream& os, const SymT& assm) const = 0;
+  virtual INST_ptr clone(void) const = 0;
+  virtual std::vector<Symb> srcs(void) const { return {}; }
+  virtual std::vector<Symb> dsts(void) const { return {}; }
+  virtual std::vector<Symb> targets(void) const { return {}; }
+  virtual bool falls(void) const { return true; }
+  virtual bool calls(void) const { return false; }
+  virtual void set_srcs([[maybe_unused]] std::vector<Symb> ss) { }
+  virtual void set_dsts([[maybe_unused]] std::vector<Symb> ds) { }
+  virtual void set_targets([[maybe_unused]] std::vector<Symb> ls) { }
 };
 
-typedef std::shared_ptr<INST> INST_ptr;
-typedef std::vector<INST_ptr> INST_vec;
 
 //
 // Basic pseudo-instructions.
@@ -81,55 +120,77 @@ typedef std::vector<INST_ptr> INST_vec;
 //
 class SET : public INST {
 public:
-    std::string dst;
+    Symb dst;
     int val;
-    SET(std::string d, int v) : dst {d}, val {v} { }
+    SET(Symb d, int v) : dst {d}, val {v} { }
     virtual ~SET(void) = default;
+    INST_ptr clone(void) const { return new SET {*this}; }
     void toMIPS(std::ostream& os, const SymT& assm) const;
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class STL : public INST {
 public:
-    std::string dst;
-    std::string lbl;
-    STL(std::string d, std::string l) : dst {d}, lbl {l} { }
+    Symb dst;
+    Symb lbl;
+    STL(Symb d, Symb l) : dst {d}, lbl {l} { }
     virtual ~STL(void) = default;
+    INST_ptr clone(void) const { return new STL {*this}; }
     void toMIPS(std::ostream& os, const SymT& assm) const;
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class MOV : public INST {
 public:
-    std::string dst;
-    std::string src;
-    MOV(std::string d, std::string s) : dst {d}, src {s} {}
+    Symb dst;
+    Symb src;
+    MOV(Symb d, Symb s) : dst {d}, src {s} {}
     virtual ~MOV(void) = default;
+    INST_ptr clone(void) const { return new MOV {*this}; }
     void toMIPS(std::ostream& os, const SymT& assm) const;
+    std::vector<Symb> srcs(void) const { return {src}; }
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_srcs(std::vector<Symb> ss) { src = ss[0]; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class ADD : public INST {
 public:
-    std::string dst;
-    std::string src1;
-    std::string src2;
-    ADD(std::string d, std::string s1, std::string s2) : dst {d}, src1 {s1}, src2 {s2} {}
+    Symb dst;
+    Symb src1;
+    Symb src2;
+    ADD(Symb d, Symb s1, Symb s2) : dst {d}, src1 {s1}, src2 {s2} {}
     virtual ~ADD(void) = default;
+    INST_ptr clone(void) const { return new ADD {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src1,src2}; }
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_srcs(std::vector<Symb> ss) { src1 = ss[0]; src2 = ss[1]; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class SUB : public INST {
 public:
-    std::string dst;
-    std::string src1;
-    std::string src2;
-    SUB(std::string d, std::string s1, std::string s2) : dst {d}, src1 {s1}, src2 {s2} {}
+    Symb dst;
+    Symb src1;
+    Symb src2;
+    SUB(Symb d, Symb s1, Symb s2) : dst {d}, src1 {s1}, src2 {s2} {}
     virtual ~SUB(void) = default;
+    INST_ptr clone(void) const { return new SUB {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src1,src2}; }
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_srcs(std::vector<Symb> ss) { src1 = ss[0]; src2 = ss[1]; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class NOP : public INST {
 public:
     NOP(void) { } 
     virtual ~NOP(void) = default;
+    INST_ptr clone(void) const { return new NOP {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
 };
 
@@ -146,44 +207,61 @@ public:
 //
 class LBL : public INST {
 public:
-    std::string lbl;
-    LBL(std::string l) : lbl {l} {}
+    Symb lbl;
+    LBL(Symb l) : lbl {l} {}
     virtual ~LBL(void) = default;
+    INST_ptr clone(void) const { return new LBL {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
 };
 
 class BCN : public INST {
 public:
     std::string cndn; // One of "lt", "eq", "le"
-    std::string src1;
-    std::string src2;
-    std::string lblt;
-    std::string lblf;
-    BCN(std::string cn, std::string  s1, std::string s2,
-        std::string lt, std::string lf) :
+    Symb src1;
+    Symb src2;
+    Symb lblt;
+    Symb lblf;
+    BCN(std::string cn, Symb  s1, Symb s2,
+        Symb lt, Symb lf) :
         cndn {cn}, src1 {s1}, src2 {s2}, lblt {lt}, lblf {lf} {}
     virtual ~BCN(void) = default;
+    INST_ptr clone(void) const { return new BCN {*this}; }
     virtual void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src1,src2}; }
+    std::vector<Symb> targets(void) const { return {lblt,lblf}; }
+    bool falls(void) const { return false; }
+    void set_srcs(std::vector<Symb> ss) { src1 = ss[0]; src2 = ss[1]; }
+    void set_targets(std::vector<Symb> ls) { lblt = ls[0]; lblf = ls[1]; }
 };
 
 class BCZ : public INST {
 public:
     std::string cndn; // One of "ltz", "eqz", "lez"
-    std::string src;
-    std::string lblt;
-    std::string lblf;
-    BCZ(std::string cn, std::string  s, std::string lt, std::string lf) :
+    Symb src;
+    Symb lblt;
+    Symb lblf;
+    BCZ(std::string cn, Symb  s, Symb lt, Symb lf) :
         cndn {cn}, src {s}, lblt {lt}, lblf {lf} {}
     virtual ~BCZ(void) = default;
+    INST_ptr clone(void) const { return new BCZ {*this}; }
     virtual void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src}; }
+    std::vector<Symb> targets(void) const { return {lblt,lblf}; }
+    bool falls(void) const { return false; }
+    void set_srcs(std::vector<Symb> ss) { src = ss[0]; }
+    void set_targets(std::vector<Symb> ls) { lblt = ls[0]; lblf = ls[1]; }
 };
 
 class JMP : public INST {
 public:
-    std::string lbl;
-    JMP(std::string l) : lbl {l} {}
+    Symb lbl;
+    JMP(Symb l) : lbl {l} {}
     virtual ~JMP(void) = default;
+    INST_ptr clone(void) const { return new JMP {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> targets(void) const { return {lbl}; }
+    bool falls(void) const { return false; }
+    void set_targets(std::vector<Symb> ls) { lbl = ls[0]; }
 };
 
 //
@@ -198,22 +276,28 @@ class ENTER : public INST {
 public:
     ENTER(void) {}
     virtual ~ENTER(void) = default;
+    INST_ptr clone(void) const { return new ENTER {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
 };
 
 class RTN : public INST {
 public:
-    std::string src;
-    RTN(std::string s) : src {s} {}
+    Symb src;
+    RTN(Symb s) : src {s} {}
     virtual ~RTN(void) = default;
+    INST_ptr clone(void) const { return new RTN {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src}; }
+    void set_srcs(std::vector<Symb> ss) { src = ss[0]; }
 };
 
 class LEAVE : public INST {
 public:
     LEAVE(void) {}
     virtual ~LEAVE(void) = default;
+    INST_ptr clone(void) const { return new LEAVE {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    bool falls(void) const { return false; }
 };
 
 //
@@ -227,26 +311,34 @@ public:
 class ARG : public INST {
 public:
     int idx;
-    std::string src;
-    ARG(int i, std::string s) : idx {i}, src {s} {}
+    Symb src;
+    ARG(int i, Symb s) : idx {i}, src {s} {}
     virtual ~ARG(void) = default;
+    INST_ptr clone(void) const { return new ARG {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src}; }
+    void set_srcs(std::vector<Symb> ss) { src = ss[0]; }
 };
 
 class RTV : public INST {
 public:
-    std::string dst;
-    RTV(std::string d) : dst {d} {}
+    Symb dst;
+    RTV(Symb d) : dst {d} {}
     virtual ~RTV(void) = default;
+    INST_ptr clone(void) const { return new RTV {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class CLL : public INST {
 public:
-    std::string lbl;
-    CLL(std::string l) : lbl {l} {}
+    Symb lbl;
+    CLL(Symb l) : lbl {l} {}
     virtual ~CLL(void) = default;
+    INST_ptr clone(void) const { return new CLL {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    bool calls(void) const { return true; }
 };
 
 //
@@ -259,26 +351,35 @@ public:
 //
 class GTI : public INST {
 public:
-    std::string dst;
-    GTI(std::string dest) : dst {dest} {} 
+    Symb dst;
+    GTI(Symb dest) : dst {dest} {} 
     virtual ~GTI(void) = default;
+    INST_ptr clone(void) const { return new GTI {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
 };
 
 class PTI : public INST {
 public:
-    std::string src;
-    PTI(std::string s) : src {s} { } 
+    Symb src;
+    PTI(Symb s) : src {s} { } 
     virtual ~PTI(void) = default;
+    INST_ptr clone(void) const { return new PTI {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src}; }
+    void set_srcs(std::vector<Symb> ss) { src = ss[0]; }
 };
 
 class PTS : public INST {
 public:
-    std::string src;
-    PTS(std::string srce) : src {srce} { } 
+    Symb src;
+    PTS(Symb srce) : src {srce} { } 
     virtual ~PTS(void) = default;
+    INST_ptr clone(void) const { return new PTS {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
+    std::vector<Symb> srcs(void) const { return {src}; }
+    void set_srcs(std::vector<Symb> ss) { src = ss[0]; }
 };
 
 
@@ -290,6 +391,7 @@ public:
     std::string msg;
     CMT(std::string m) : msg {m} {}
     virtual ~CMT(void) = default;
+    INST_ptr clone(void) const { return new CMT {*this}; }
     void toMIPS(std::ostream& os, const SymT& symt) const;
 };
 
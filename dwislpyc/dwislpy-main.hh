@@ -42,6 +42,9 @@ typedef std::shared_ptr<std::istream> istream_ptr;
  *   parse - runs the parser, building the AST
  *   set - sets the AST that results from a parse
  *   run - executes the parsed DwiDlpy program
+ *   walk - executes it by walking its AST instead
+ *   dump_bcode - outputs the bytecode that `run` executes
+ *   compile - compiles it to MIPS, optimizing as chosen
  *   dump - (pretty) prints the AST
  *
  * Note that the constructor attempts to create a stream attached to
@@ -56,8 +59,10 @@ namespace DWISLPY {
         Driver(std::string filename);
         void parse(void);
         void run(void);
+        void walk(void);
+        void dump_bcode(void);
         void check(void);
-        void compile(void);
+        void compile(const Opts& opts);
         void dump(bool pretty);
         void set(Prgm_ptr prgm) { program = prgm; }
         std::string src_name;
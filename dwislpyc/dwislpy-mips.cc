@@ -1,6 +1,12 @@
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <algorithm>
 #include "dwislpy-inst.hh"
+#include "dwislpy-regs.hh"
+#include "dwislpy-inln.hh"
+#include "dwislpy-opt.hh"
+#include "dwislpy-peep.hh"
 #include "dwislpy-ast.hh"
 #include "dwislpy-check.hh"
 #include "dwislpy-util.hh"
@@ -15,10 +21,17 @@
 //
 // which relies on
 //
+//     eliminate_tail_calls
+//     inline_calls
+//     optimize
+//     allocate_registers
+//     share_frame_slots
 //     defn_compile
+//     peephole
 //
-// to produce MIPS32 code for every `def` body and for the `main`
-// script.
+// to improve the IR, to place variables in registers or frame slots, to
+// produce MIPS32 code for every `def` body and for the `main` script, and
+// to clean that code up.
 //
 // These functions, in turn, rely on `INST::toMIPS` which is
 // implemented for any sub-class of `INST`.
@@ -26,6 +39,7 @@
 
 #define RETURN_ADDRESS "saved_return_address"
 #define FRAME_POINTER  "saved_frame_pointer"
+#define SAVED_REGISTER(r) ("saved_" + (r).substr(1))
 
 // compile_defn(os,symt,code)
 //
@@ -35,16 +49,35 @@
 // `code` and converts each IR instruction (using `toMIPS`) into
 // MIPS32 code.
 //
-void compile_defn(std::ostream& os, SymT& symt, INST_vec& code) {
-    int num_frmls = symt.get_frmls_size();
-    int num_locls = symt.get_locls_size();
-    int num_cargs = 4; // Max # of args of any F/PCll within this def.
-
+// Only the locals and temporaries that `allocate_registers` didn't
+// place in a register get a frame slot, and those can share slots as
+// numbered by `share_frame_slots`. The frame also has slots for
+// saving any callee-saved registers used by the code.
+//
+// A leaf makes no calls, and so it doesn't save `$ra` or leave room
+// for the arguments of calls. If, on top of that, all its variables
+// are kept in registers, then it gets no frame at all.
+//
+// The frame size is reported in a comment, along with the size it
+// would have had with one slot for each local and temporary.
+//
+int aligned_frame_size(int num_slots, int num_cargs, int num_links) {
     // Calculate a double-word aligned frame size.
-    int frame_size = 4*(num_locls + num_cargs + 2);
+    int frame_size = 4*(num_slots + num_cargs + num_links);
     if (frame_size % 8 != 0) {
         frame_size += 4;
     }
+    return frame_size;
+}
+//
+void compile_defn(std::ostream& os, SymT& symt, INST_vec& code) {
+    int num_frmls = symt.get_frmls_size();
+    int num_locls = symt.get_locls_size();
+    int num_cargs = 4; // Max # of args of any F/PCll within this def.
+    int num_links = 2; // Slots for saving $ra and $fp.
+    int num_slots = 0;
+    int num_unshared = 0;
+    bool in_frame = false; // Whether any variable lives in the frame.
     
     //
     // Frame layout according to calling conventions.
@@ -57,50 +90,147 @@ void compile_defn(std::ostream& os, SymT& symt, INST_vec& code) {
     for (int i = 0; i < num_frmls; i++) {
         std::string frml = symt.get_frml(i)->name;
         symt.set_frame_offset(frml,i*4);
+        if (!symt.has_register(frml)) {
+            in_frame = true;
+        }
     }
 
-    int offset = -4;
-        
-    // Locals sit next.
+    // Locals kept in the frame sit next.
     for (int i = 0; i < num_locls; i++) {
         std::string locl = symt.get_locl(i)->name;
-        symt.set_frame_offset(locl,offset);
+        if (!symt.has_register(locl)) {
+            num_unshared++;
+        }
+        int slot = symt.get_frame_slot(locl);
+        if (slot >= 0) {
+            symt.set_frame_offset(locl,-4*(slot+1));
+            num_slots = std::max(num_slots, slot+1);
+            in_frame = true;
+        }
+    }
+
+    int offset = -4*(num_slots+1);
+
+    // Callee-saved registers used by the code sit next.
+    for (std::string reg : symt.get_saved()) {
+        std::string sv = symt.add_locl(SAVED_REGISTER(reg), IntTy {});
+        symt.set_frame_offset(sv,offset);
         offset -= 4;
+        num_slots++;
+        num_unshared++;
+        in_frame = true;
     }
 
-    // Saved registers sit next.
-    std::string ra = symt.add_locl(RETURN_ADDRESS, IntTy {}); // Not really an integer.
+    // Saved registers sit next. A leaf only saves $fp.
+    if (symt.is_leaf()) {
+        num_cargs = 0;
+        num_links = 1;
+    } else {
+        std::string ra = symt.add_locl(RETURN_ADDRESS, IntTy {}); // Not really an integer.
+        symt.set_frame_offset(ra,offset);
+        offset -= 4;
+    }
     std::string fp = symt.add_locl(FRAME_POINTER, IntTy {});  // Not really an integer.
-    symt.set_frame_offset(ra,offset);
-    offset -= 4;
     symt.set_frame_offset(fp,offset);
     offset -= 4;
 
     // Possible arguments to calls sit last.
     
-    symt.set_frame_size(frame_size);
+    if (symt.is_leaf() && !in_frame) {
+        symt.set_frame_size(0);
+    } else {
+        symt.set_frame_size(aligned_frame_size(num_slots,num_cargs,num_links));
+    }
+    symt.set_unshared_frame_size(aligned_frame_size(num_unshared,num_cargs,num_links));
 
+    os << "\t\t\t\t# frame size " << symt.get_frame_size()
+       << " (unshared " << symt.get_unshared_frame_size() << ")" << std::endl;
     for (INST_ptr inst : code) {
         inst->toMIPS(os,symt);
     }
 }
 
-// Prgm::compile(os)
+// output_defn(os,symt,code,opts)
 //
-// Generate MIPS32 code into `os`, relying on `compile_defn` to generate
-// the machine code for each of the `def`s and the `main` script. It also
+// Generate the MIPS32 code for `code` with `compile_defn` and output it
+// to `os`, first running it through the peephole optimizer if `opts`
+// says to.
+//
+void output_defn(std::ostream& os, SymT& symt, INST_vec& code,
+                 const Opts& opts) {
+    if (!opts.peephole) {
+        compile_defn(os,symt,code);
+        return;
+    }
+    std::stringstream mips_stream { };
+    compile_defn(mips_stream,symt,code);
+    Mips_vec mips = read_mips(mips_stream);
+    peephole(mips);
+    write_mips(os,mips);
+}
+
+// Prgm::compile(os,opts)
+//
+// Generate MIPS32 code into `os`, relying on `output_defn` to generate
+// the machine code for each of the `def`s and the `main` script. The IR
+// is first run through the optimizer passes chosen by `opts`. It also
 // sets up the global information about all the string constants that were
 // discovered duting translation to the IR. 
 //
 // The resulting file (represented by `os`) will contain a SPIM-executable
 // .s file.
 //
-void Prgm::compile(std::ostream& os) {
+void Prgm::compile(std::ostream& os, const Opts& opts) {
 
-    // Translate the AST to IR.
+    // Fold the constants of the AST, then translate it to IR.
     //
+    if (opts.fold) {
+        fold();
+    }
     trans();
 
+    // Turn self tail calls into loops.
+    //
+    if (opts.tail_calls) {
+        for (std::pair<Name,Defn_ptr> dfpr : defs) {
+            eliminate_tail_calls(*dfpr.second);
+        }
+    }
+
+    // Inline the calls to small `def`s, those within the `def`s first
+    // so that the ones calling them may become small enough too.
+    //
+    if (opts.inln) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (std::pair<Name,Defn_ptr> dfpr : defs) {
+                Defn_ptr defn = dfpr.second;
+                changed = inline_calls(defs,defn->symt,defn->code) || changed;
+            }
+        }
+        inline_calls(defs,main_symt,main_code);
+    }
+
+    // Optimize the IR.
+    //
+    optimize(main_symt,main_code,opts);
+    for (std::pair<Name,Defn_ptr> dfpr : defs) {
+        Defn_ptr defn = dfpr.second;
+        optimize(defn->symt,defn->code,opts);
+    }
+
+    // Place variables and temporaries in registers, or else in
+    // (possibly shared) frame slots.
+    //
+    allocate_registers(main_symt,main_code);
+    share_frame_slots(main_symt,main_code);
+    for (std::pair<Name,Defn_ptr> dfpr : defs) {
+        Defn_ptr defn = dfpr.second;
+        allocate_registers(defn->symt,defn->code);
+        share_frame_slots(defn->symt,defn->code);
+    }
+
     // Generate the `.data` section filled with string constants.
     //
     os << "\t.data" << std::endl;
@@ -116,10 +246,10 @@ void Prgm::compile(std::ostream& os) {
     //
     os << "\t.text" << std::endl;
     os << "\t.globl main" << std::endl;
-    compile_defn(os,main_symt,main_code);
+    output_defn(os,main_symt,main_code,opts);
     for (std::pair<Name,Defn_ptr> dfpr : defs) {
         Defn_ptr defn = dfpr.second;
-        compile_defn(os,defn->symt,defn->code);
+        output_defn(os,defn->symt,defn->code,opts);
     }
 }
 
@@ -131,61 +261,128 @@ void Prgm::compile(std::ostream& os) {
 //
 // The method outputs a series of MIPS instructions to the output
 // stream `os`, using information about frame variables and strings
-// held in `symt`. In particular, it loads variables from the stack
-// frame at their assigned offset within the frame to set some MIPS
-// registers and/or stores register values to the stack frame if they
-// are being updated.
+// held in `symt`. A variable that was given a register is operated on
+// directly. Otherwise it is loaded from the stack frame at its assigned
+// offset into one of the scratch registers $t0-$t2, and/or stored back
+// to the stack frame if it is being updated.
 // 
-// We define this method for each subclass of INST.
+// We define this method for each subclass of INST. They rely on these
+// helpers:
+//
+// * src_reg(os,symt,nm,scratch) - gives the register holding `nm`,
+//       loading it into `scratch` if it lives in the frame.
+// * dst_reg(symt,nm,scratch) - gives the register to compute a new
+//       value of `nm` into; `scratch` if it lives in the frame.
+// * dst_store(os,symt,nm,reg) - stores the new value of `nm` from
+//       `reg` if it lives in the frame.
+// * load_into(os,symt,nm,reg) - copies `nm` into a specific `reg`.
+// * copy_to(os,symt,nm,reg) - copies a specific `reg` into `nm`.
+//
+std::string src_reg(std::ostream& os, const SymT& symt,
+                    Symb nm, std::string scratch) {
+    if (symt.has_register(nm)) {
+        return symt.get_register(nm);
+    }
+    os << "\t" << "lw " << scratch << "," << symt.get_frame_offset(nm) << "($fp)" << std::endl;
+    return scratch;
+}
 //
+std::string dst_reg(const SymT& symt, Symb nm, std::string scratch) {
+    if (symt.has_register(nm)) {
+        return symt.get_register(nm);
+    }
+    return scratch;
+}
+//
+void dst_store(std::ostream& os, const SymT& symt,
+               Symb nm, std::string reg) {
+    if (!symt.has_register(nm)) {
+        os << "\t" << "sw " << reg << "," << symt.get_frame_offset(nm) << "($fp)" << std::endl;
+    }
+}
+//
+void load_into(std::ostream& os, const SymT& symt,
+               Symb nm, std::string reg) {
+    if (symt.has_register(nm)) {
+        os << "\t" << "move " << reg << "," << symt.get_register(nm) << std::endl;
+    } else {
+        os << "\t" << "lw " << reg << "," << symt.get_frame_offset(nm) << "($fp)" << std::endl;
+    }
+}
+//
+void copy_to(std::ostream& os, const SymT& symt,
+             Symb nm, std::string reg) {
+    if (symt.has_register(nm)) {
+        if (symt.get_register(nm) != reg) {
+            os << "\t" << "move " << symt.get_register(nm) << "," << reg << std::endl;
+        }
+    } else {
+        os << "\t" << "sw " << reg << "," << symt.get_frame_offset(nm) << "($fp)" << std::endl;
+    }
+}
 //
 void ENTER::toMIPS(std::ostream& os, const SymT& symt) const {
-    int ra_slot = symt.get_frame_offset(RETURN_ADDRESS);
-    int fp_slot = symt.get_frame_offset(FRAME_POINTER);
-    os << "\t" << "sw $ra," << ra_slot << "($sp)" << std::endl;
-    os << "\t" << "sw $fp," << fp_slot << "($sp)" << std::endl;
-    os << "\t" << "move $fp, $sp" << std::endl;
-    os << "\t" << "addi $sp,$sp,-" << symt.get_frame_size() << std::endl;
+    if (symt.get_frame_size() > 0) {
+        int fp_slot = symt.get_frame_offset(FRAME_POINTER);
+        if (!symt.is_leaf()) {
+            int ra_slot = symt.get_frame_offset(RETURN_ADDRESS);
+            os << "\t" << "sw $ra," << ra_slot << "($sp)" << std::endl;
+        }
+        os << "\t" << "sw $fp," << fp_slot << "($sp)" << std::endl;
+        os << "\t" << "move $fp, $sp" << std::endl;
+        os << "\t" << "addi $sp,$sp,-" << symt.get_frame_size() << std::endl;
+    }
+    for (std::string reg : symt.get_saved()) {
+        int slot = symt.get_frame_offset(SAVED_REGISTER(reg));
+        os << "\t" << "sw " << reg << "," << slot << "($fp)" << std::endl;
+    }
     for (int argi = 0; argi < symt.get_frmls_size(); argi++) {
         std::string pram = symt.get_frml(argi)->name;
-        int slot = symt.get_frame_offset(pram);
-        os << "\t" << "sw $a" << argi << "," << slot << "($fp)" << std::endl;
+        copy_to(os,symt,pram,"$a" + std::to_string(argi));
     }
 }
 //
 void LEAVE::toMIPS(std::ostream& os, const SymT& symt) const {
-    int ra_slot = symt.get_frame_offset(RETURN_ADDRESS);
-    int fp_slot = symt.get_frame_offset(FRAME_POINTER);
-    os << "\t" << "lw $ra," << ra_slot << "($fp)" << std::endl;
-    os << "\t" << "lw $fp," << fp_slot << "($fp)" << std::endl;
-    os << "\t" << "addi $sp,$sp," << symt.get_frame_size() << std::endl;
+    for (std::string reg : symt.get_saved()) {
+        int slot = symt.get_frame_offset(SAVED_REGISTER(reg));
+        os << "\t" << "lw " << reg << "," << slot << "($fp)" << std::endl;
+    }
+    if (symt.get_frame_size() > 0) {
+        int fp_slot = symt.get_frame_offset(FRAME_POINTER);
+        if (!symt.is_leaf()) {
+            int ra_slot = symt.get_frame_offset(RETURN_ADDRESS);
+            os << "\t" << "lw $ra," << ra_slot << "($fp)" << std::endl;
+        }
+        os << "\t" << "lw $fp," << fp_slot << "($fp)" << std::endl;
+        os << "\t" << "addi $sp,$sp," << symt.get_frame_size() << std::endl;
+    }
     os << "\t" << "jr $ra" << std::endl;
 }
 void SET::toMIPS(std::ostream& os, const SymT& symt) const {
-  os << "\t" << "li $t0," << val << std::endl;
-  os << "\t" << "sw $t0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    std::string rd = dst_reg(symt,dst,"$t0");
+    os << "\t" << "li " << rd << "," << val << std::endl;
+    dst_store(os,symt,dst,rd);
 }
 //
 void STL::toMIPS(std::ostream& os, const SymT& symt) const { 
-    os << "\t" << "la $t0," << lbl << std::endl;
-    os << "\t" << "sw $t0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    std::string rd = dst_reg(symt,dst,"$t0");
+    os << "\t" << "la " << rd << "," << lbl << std::endl;
+    dst_store(os,symt,dst,rd);
 }
 //
 void MOV::toMIPS(std::ostream& os, const SymT& symt) const {
-  os << "\t" << "lw $t1," << symt.get_frame_offset(src) << "($fp)" << std::endl;
-  os << "\t" << "move $t0,$t1" << std::endl;
-  os << "\t" << "sw $t0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    std::string rs = src_reg(os,symt,src,"$t1");
+    copy_to(os,symt,dst,rs);
 }
 //
 void RTV::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "move $t0,$v0" << std::endl;
-    os << "\t" << "sw $t0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    copy_to(os,symt,dst,"$v0");
 }
 //
 void GTI::toMIPS(std::ostream& os, const SymT& symt) const {
     os << "\t" << "li $v0,5" << std::endl;
     os << "\t" << "syscall" << std::endl;
-    os << "\t" << "sw $v0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    copy_to(os,symt,dst,"$v0");
 }
 //
 void NOP::toMIPS(std::ostream& os, const SymT& symt) const {
@@ -193,45 +390,47 @@ void NOP::toMIPS(std::ostream& os, const SymT& symt) const {
 }
 //
 void PTI::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $a0," << symt.get_frame_offset(src) << "($fp)" << std::endl;
+    load_into(os,symt,src,"$a0");
     os << "\t" << "li $v0,1" << std::endl;
     os << "\t" << "syscall" << std::endl;
 }
 //
 void PTS::toMIPS(std::ostream& os, const SymT& symt) const {
     os << "\t" << "li $v0,4" << std::endl;
-    os << "\t" << "lw $a0," << symt.get_frame_offset(src) << "($fp)" << std::endl;
+    load_into(os,symt,src,"$a0");
     os << "\t" << "syscall" << std::endl;
 }
 //
 void ADD::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $t1," << symt.get_frame_offset(src1) << "($fp)" << std::endl;
-    os << "\t" << "lw $t2," << symt.get_frame_offset(src2) << "($fp)" << std::endl;
-    os << "\t" << "add $t0,$t1,$t2" << std::endl;
-    os << "\t" << "sw $t0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    std::string r1 = src_reg(os,symt,src1,"$t1");
+    std::string r2 = src_reg(os,symt,src2,"$t2");
+    std::string rd = dst_reg(symt,dst,"$t0");
+    os << "\t" << "add " << rd << "," << r1 << "," << r2 << std::endl;
+    dst_store(os,symt,dst,rd);
 }
 //
 void SUB::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $t1," << symt.get_frame_offset(src1) << "($fp)" << std::endl;
-    os << "\t" << "lw $t2," << symt.get_frame_offset(src2) << "($fp)" << std::endl;
-    os << "\t" << "sub $t0,$t1,$t2" << std::endl;
-    os << "\t" << "sw $t0," << symt.get_frame_offset(dst) << "($fp)" << std::endl;
+    std::string r1 = src_reg(os,symt,src1,"$t1");
+    std::string r2 = src_reg(os,symt,src2,"$t2");
+    std::string rd = dst_reg(symt,dst,"$t0");
+    os << "\t" << "sub " << rd << "," << r1 << "," << r2 << std::endl;
+    dst_store(os,symt,dst,rd);
 }
 //
 void RTN::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $v0," << symt.get_frame_offset(src) << "($fp)" << std::endl;
+    load_into(os,symt,src,"$v0");
 }
 //
 void BCN::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $t1," << symt.get_frame_offset(src1) << "($fp)" << std::endl;
-    os << "\t" << "lw $t2," << symt.get_frame_offset(src2) << "($fp)" << std::endl;
-    os << "\t" << "b" << cndn << " $t1,$t2," << lblt << std::endl;
+    std::string r1 = src_reg(os,symt,src1,"$t1");
+    std::string r2 = src_reg(os,symt,src2,"$t2");
+    os << "\t" << "b" << cndn << " " << r1 << "," << r2 << "," << lblt << std::endl;
     os << "\t" << "j " << lblf << std::endl;
 }
 //
 void BCZ::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $t1," << symt.get_frame_offset(src) << "($fp)" << std::endl;
-    os << "\t" << "b" << cndn << " $t1," << lblt << std::endl;
+    std::string r = src_reg(os,symt,src,"$t1");
+    os << "\t" << "b" << cndn << " " << r << "," << lblt << std::endl;
     os << "\t" << "j " << lblf << std::endl;
 }
 //
@@ -252,6 +451,5 @@ void CMT::toMIPS(std::ostream& os, const SymT& symt) const {
 }
 //
 void ARG::toMIPS(std::ostream& os, const SymT& symt) const {
-    os << "\t" << "lw $a" << idx << ","
-       << symt.get_frame_offset(src) << "($fp)" << std::endl;
+    load_into(os,symt,src,"$a" + std::to_string(idx));
 }
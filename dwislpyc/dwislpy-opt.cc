@@ -0,0 +1,1162 @@
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <climits>
+#include <optional>
+
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+#include "dwislpy-regs.hh"
+#include "dwislpy-opt.hh"
+
+//
+// dwislpy-opt.cc
+//
+// This gives the optimizer described in `dwislpy-opt.hh`. It has
+// these parts:
+//
+//  * `Flow`, the control flow graph of a function's code along with
+//    its dominator tree,
+//  * `to_ssa` and `from_ssa`, which take the code into and back out
+//    of SSA form,
+//  * a function for each of the passes, and
+//  * `optimize`, the pass manager that puts them together.
+//
+
+// * * * * *
+//
+// class PHI
+//
+// The phi function of SSA form. At the start of a block where several
+// versions of the variable `var` meet, `PHI d,a1,...,an` sets `d` to
+// `ai` when control came from the block numbered `preds[i]`.
+//
+// PHIs only exist while the code is in SSA form, and so they are never
+// converted to MIPS.
+//
+class PHI : public INST {
+public:
+    Symb dst;
+    Symb var;
+    std::vector<Symb> args;
+    std::vector<int> preds;
+    PHI(Symb v) : dst {v}, var {v}, args {}, preds {} { }
+    virtual ~PHI(void) = default;
+    INST_ptr clone(void) const { return new PHI {*this}; }
+    void toMIPS([[maybe_unused]] std::ostream& os,
+                [[maybe_unused]] const SymT& symt) const { }
+    std::vector<Symb> srcs(void) const { return args; }
+    std::vector<Symb> dsts(void) const { return {dst}; }
+    void set_srcs(std::vector<Symb> ss) { args = ss; }
+    void set_dsts(std::vector<Symb> ds) { dst = ds[0]; }
+};
+
+// * * * * *
+//
+// class BBlk
+//
+// A basic block: a run of instructions that is only entered at its
+// start and only left at its end. Along with its code, it records its
+// neighbors in the control flow graph and in the dominator tree. A
+// block is `live` if it can be reached from the function's entry.
+//
+class BBlk {
+public:
+    INST_vec code;
+    std::vector<int> succs { };
+    std::vector<int> preds { };
+    bool live = true;
+    int idom = -1;                  // Its immediate dominator.
+    std::vector<int> kids { };      // The blocks it immediately dominates.
+    std::vector<int> frontier { };  // Its dominance frontier.
+    int enter = -1;                 // When a walk of the dominator tree
+    int leave = -1;                 //   enters and leaves it.
+};
+
+//
+// class Flow
+//
+// The control flow graph of a function's code. Blocks are numbered
+// in the order they appear in the code, with the entry block first.
+//
+//  * link - works out the edges between blocks from their code, marks
+//           the blocks that can no longer be reached as dead, and then
+//           recomputes the dominator tree.
+//  * walk - visits the live blocks in a depth-first walk of the
+//           dominator tree, calling `enter` on the way down to a block
+//           and `leave` on the way back up.
+//  * layout - lays the code of the live blocks back out in order.
+//  * dominates - whether every path from the entry to block `b2` goes
+//           through block `b1`.
+//
+class Flow {
+public:
+    std::vector<BBlk> blks;
+    Flow(const INST_vec& code);
+    void link(void);
+    bool dominates(int b1, int b2) const;
+    void walk(std::function<void(int)> enter,
+              std::function<void(int)> leave) const;
+    INST_vec layout(void) const;
+private:
+    void dominate(void);
+};
+
+//
+// Flow(code)
+//
+// Split `code` into blocks. A new block starts at each label, and
+// after each jump or branch.
+//
+Flow::Flow(const INST_vec& code) : blks { } {
+    for (INST_ptr inst : code) {
+        if (blks.empty()
+            || dynamic_cast<LBL*>(inst) != nullptr
+            || !blks.back().code.back()->falls()
+            || !blks.back().code.back()->targets().empty()) {
+            blks.push_back(BBlk { });
+        }
+        blks.back().code.push_back(inst);
+    }
+    link();
+}
+
+void Flow::link(void) {
+    std::unordered_map<Symb,int> label_at { };
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        blks[b].succs.clear();
+        blks[b].preds.clear();
+        if (!blks[b].live || blks[b].code.empty()) {
+            continue;
+        }
+        if (LBL* lbl = dynamic_cast<LBL*>(blks[b].code.front())) {
+            label_at[lbl->lbl] = b;
+        }
+    }
+
+    // Connect each block to the ones it jumps or falls to.
+    //
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        if (!blks[b].live) {
+            continue;
+        }
+        std::vector<int>& succs = blks[b].succs;
+        auto connect = [&](int s) {
+            if (std::find(succs.begin(), succs.end(), s) == succs.end()) {
+                succs.push_back(s);
+            }
+        };
+        if (!blks[b].code.empty()) {
+            for (Symb lbl : blks[b].code.back()->targets()) {
+                if (label_at.count(lbl) > 0) {
+                    connect(label_at.at(lbl));
+                }
+            }
+        }
+        if ((blks[b].code.empty() || blks[b].code.back()->falls())
+            && b+1 < blks.size() && blks[b+1].live) {
+            connect(b+1);
+        }
+    }
+
+    // Find the blocks that can still be reached from the entry.
+    //
+    std::vector<bool> seen (blks.size(), false);
+    std::vector<int> work {0};
+    seen[0] = true;
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        for (int s : blks[b].succs) {
+            if (!seen[s]) {
+                seen[s] = true;
+                work.push_back(s);
+            }
+        }
+    }
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        if (!seen[b]) {
+            blks[b].live = false;
+            blks[b].succs.clear();
+        }
+    }
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        for (int s : blks[b].succs) {
+            blks[s].preds.push_back(b);
+        }
+    }
+
+    // PHIs lose their arguments from blocks that are no longer
+    // predecessors.
+    //
+    for (BBlk& blk : blks) {
+        for (INST_ptr inst : blk.code) {
+            if (PHI* phi = dynamic_cast<PHI*>(inst)) {
+                std::vector<Symb> args { };
+                std::vector<int> preds { };
+                for (unsigned int i = 0; i < phi->args.size(); i++) {
+                    if (std::find(blk.preds.begin(), blk.preds.end(),
+                                  phi->preds[i]) != blk.preds.end()) {
+                        args.push_back(phi->args[i]);
+                        preds.push_back(phi->preds[i]);
+                    }
+                }
+                phi->args = args;
+                phi->preds = preds;
+            }
+        }
+    }
+
+    dominate();
+}
+
+//
+// Flow::dominate()
+//
+// Compute the dominator tree with the iterative algorithm of Cooper,
+// Harvey, and Kennedy, and then each block's dominance frontier.
+//
+void Flow::dominate(void) {
+    // Number the live blocks in postorder.
+    //
+    std::vector<int> order { };
+    std::vector<int> number (blks.size(), -1);
+    std::vector<bool> seen (blks.size(), false);
+    std::vector<std::pair<int,unsigned int>> stack { {0,0} };
+    seen[0] = true;
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        unsigned int i = stack.back().second;
+        if (i < blks[b].succs.size()) {
+            stack.back().second++;
+            int s = blks[b].succs[i];
+            if (!seen[s]) {
+                seen[s] = true;
+                stack.push_back({s,0});
+            }
+        } else {
+            number[b] = order.size();
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    for (BBlk& blk : blks) {
+        blk.idom = -1;
+        blk.kids.clear();
+        blk.frontier.clear();
+    }
+    auto intersect = [&](int b1, int b2) {
+        while (b1 != b2) {
+            while (number[b1] < number[b2]) b1 = blks[b1].idom;
+            while (number[b2] < number[b1]) b2 = blks[b2].idom;
+        }
+        return b1;
+    };
+    blks[0].idom = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b : order) {
+            if (b == 0) {
+                continue;
+            }
+            int idom = -1;
+            for (int p : blks[b].preds) {
+                if (blks[p].idom >= 0) {
+                    idom = (idom < 0) ? p : intersect(p,idom);
+                }
+            }
+            if (idom != blks[b].idom) {
+                blks[b].idom = idom;
+                changed = true;
+            }
+        }
+    }
+
+    for (unsigned int b = 1; b < blks.size(); b++) {
+        if (blks[b].live) {
+            blks[blks[b].idom].kids.push_back(b);
+        }
+    }
+
+    // Number the walk of the dominator tree, so that `dominates` need
+    // not climb it.
+    //
+    int tick = 0;
+    for (BBlk& blk : blks) {
+        blk.enter = -1;
+        blk.leave = -1;
+    }
+    walk([&](int b) { blks[b].enter = tick++; },
+         [&](int b) { blks[b].leave = tick++; });
+
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        if (blks[b].preds.size() < 2) {
+            continue;
+        }
+        for (int p : blks[b].preds) {
+            for (int r = p; r != blks[b].idom; r = blks[r].idom) {
+                std::vector<int>& frontier = blks[r].frontier;
+                if (std::find(frontier.begin(), frontier.end(), b)
+                    == frontier.end()) {
+                    frontier.push_back(b);
+                }
+            }
+        }
+    }
+}
+
+bool Flow::dominates(int b1, int b2) const {
+    if (b1 == b2) {
+        return true;
+    }
+    if (blks[b1].enter < 0 || blks[b2].enter < 0) {
+        return false;
+    }
+    return blks[b1].enter < blks[b2].enter && blks[b2].leave < blks[b1].leave;
+}
+
+void Flow::walk(std::function<void(int)> enter,
+                std::function<void(int)> leave) const {
+    std::vector<std::pair<int,unsigned int>> stack { {0,0} };
+    enter(0);
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        unsigned int i = stack.back().second;
+        if (i < blks[b].kids.size()) {
+            stack.back().second++;
+            int k = blks[b].kids[i];
+            enter(k);
+            stack.push_back({k,0});
+        } else {
+            leave(b);
+            stack.pop_back();
+        }
+    }
+}
+
+INST_vec Flow::layout(void) const {
+    INST_vec code { };
+    for (const BBlk& blk : blks) {
+        if (blk.live) {
+            code.insert(code.end(), blk.code.begin(), blk.code.end());
+        }
+    }
+    return code;
+}
+
+// * * * * *
+//
+// to_ssa(flow,symt)
+//
+// Put the code into SSA form. Only variables written by more than one
+// instruction need work, along with formals that get assigned. For
+// each of these, PHIs are placed at the iterated dominance frontier of
+// the blocks that write it. Then each write is given a new version of
+// the variable, named like `x.1`, `x.2`, ..., and each read is renamed
+// to the version that reaches it. A formal's value on entry keeps the
+// formal's name.
+//
+void to_ssa(Flow& flow, SymT& symt) {
+    std::vector<BBlk>& blks = flow.blks;
+
+    // Find where each variable is written.
+    //
+    std::vector<Symb> vars { };
+    std::unordered_map<Symb,std::vector<int>> writes { };
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        if (!blks[b].live) {
+            continue;
+        }
+        for (INST_ptr inst : blks[b].code) {
+            for (Symb nm : inst->dsts()) {
+                if (!symt.has_info(nm)) {
+                    continue;
+                }
+                if (writes.count(nm) == 0) {
+                    vars.push_back(nm);
+                }
+                writes[nm].push_back(b);
+            }
+        }
+    }
+    std::unordered_map<Symb,bool> renamed { };
+    for (Symb nm : vars) {
+        if (writes.at(nm).size() > 1 || symt.get_info(nm)->kind == FRML) {
+            renamed[nm] = true;
+        }
+    }
+
+    // Place the PHIs.
+    //
+    for (Symb nm : vars) {
+        if (!renamed[nm]) {
+            continue;
+        }
+        std::vector<int> work = writes.at(nm);
+        if (symt.get_info(nm)->kind == FRML) {
+            work.push_back(0);
+        }
+        std::vector<bool> written (blks.size(), false);
+        std::vector<bool> placed (blks.size(), false);
+        for (int b : work) {
+            written[b] = true;
+        }
+        while (!work.empty()) {
+            int b = work.back();
+            work.pop_back();
+            for (int f : blks[b].frontier) {
+                if (placed[f]) {
+                    continue;
+                }
+                placed[f] = true;
+                PHI* phi = new PHI {nm};
+                for (int p : blks[f].preds) {
+                    phi->args.push_back(nm);
+                    phi->preds.push_back(p);
+                }
+                INST_vec& code = blks[f].code;
+                bool labelled = dynamic_cast<LBL*>(code.front()) != nullptr;
+                code.insert(code.begin() + (labelled ? 1 : 0), INST_ptr {phi});
+                if (!written[f]) {
+                    written[f] = true;
+                    work.push_back(f);
+                }
+            }
+        }
+    }
+
+    // Rename, keeping a stack of each variable's current version.
+    //
+    std::unordered_map<Symb,std::vector<Symb>> versions { };
+    std::unordered_map<Symb,int> count { };
+    std::vector<std::vector<Symb>> pushed (blks.size());
+    auto current = [&](Symb nm) {
+        if (!renamed[nm] || versions[nm].empty()) {
+            return nm;
+        }
+        return versions[nm].back();
+    };
+    auto enter = [&](int b) {
+        auto fresh = [&](Symb nm) {
+            if (!renamed[nm]) {
+                return nm;
+            }
+            Symb vnm = nm.name() + "." + std::to_string(++count[nm]);
+            symt.add_temp(vnm.name(), symt.get_info(nm)->type);
+            versions[nm].push_back(vnm);
+            pushed[b].push_back(nm);
+            return vnm;
+        };
+        for (INST_ptr inst : blks[b].code) {
+            if (PHI* phi = dynamic_cast<PHI*>(inst)) {
+                phi->dst = fresh(phi->var);
+                continue;
+            }
+            std::vector<Symb> srcs = inst->srcs();
+            for (Symb& nm : srcs) {
+                nm = current(nm);
+            }
+            inst->set_srcs(srcs);
+            std::vector<Symb> dsts = inst->dsts();
+            for (Symb& nm : dsts) {
+                nm = fresh(nm);
+            }
+            inst->set_dsts(dsts);
+        }
+        for (int s : blks[b].succs) {
+            for (INST_ptr inst : blks[s].code) {
+                if (PHI* phi = dynamic_cast<PHI*>(inst)) {
+                    for (unsigned int i = 0; i < phi->preds.size(); i++) {
+                        if (phi->preds[i] == b) {
+                            phi->args[i] = current(phi->var);
+                        }
+                    }
+                }
+            }
+        }
+    };
+    auto leave = [&](int b) {
+        for (Symb nm : pushed[b]) {
+            versions[nm].pop_back();
+        }
+    };
+    flow.walk(enter,leave);
+}
+
+//
+// from_ssa(flow,symt)
+//
+// Take the code out of SSA form. Each `PHI d,...` gets a fresh
+// temporary `t`. Each predecessor copies its argument into `t` at its
+// end, and the PHI itself becomes `MOV d,t`. Going through `t` keeps
+// these copies from clobbering a value that another one still needs.
+//
+// Where an argument is computed in its predecessor only to feed the
+// PHI, it is computed straight into `t` instead.
+//
+void from_ssa(Flow& flow, SymT& symt) {
+    std::vector<BBlk>& blks = flow.blks;
+    std::unordered_map<Symb,int> uses { };
+    std::unordered_map<Symb,std::pair<int,INST_ptr>> written_by { };
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        if (!blks[b].live) {
+            continue;
+        }
+        for (INST_ptr inst : blks[b].code) {
+            for (Symb nm : inst->srcs()) {
+                uses[nm]++;
+            }
+            if (dynamic_cast<PHI*>(inst) == nullptr) {
+                for (Symb nm : inst->dsts()) {
+                    written_by[nm] = {b,inst};
+                }
+            }
+        }
+    }
+
+    std::vector<INST_vec> copies (blks.size());
+    for (BBlk& blk : blks) {
+        if (!blk.live) {
+            continue;
+        }
+        for (INST_ptr& inst : blk.code) {
+            PHI* phi = dynamic_cast<PHI*>(inst);
+            if (phi == nullptr) {
+                continue;
+            }
+            Symb temp = symt.add_temp(symt.get_info(phi->dst)->type);
+            for (unsigned int i = 0; i < phi->args.size(); i++) {
+                Symb arg = phi->args[i];
+                int p = phi->preds[i];
+                if (uses[arg] == 1 && written_by.count(arg) > 0
+                    && written_by.at(arg).first == p) {
+                    written_by.at(arg).second->set_dsts({temp});
+                } else {
+                    copies[p].push_back(INST_ptr {new MOV {temp,arg}});
+                }
+            }
+            inst = INST_ptr {new MOV {phi->dst,temp}};
+        }
+    }
+
+    // Place the copies at the end of each block, but before any jump.
+    //
+    for (unsigned int b = 0; b < blks.size(); b++) {
+        INST_vec& code = blks[b].code;
+        INST_vec::iterator at = code.end();
+        if (!code.empty()
+            && (!code.back()->falls() || !code.back()->targets().empty())) {
+            at--;
+        }
+        code.insert(at, copies[b].begin(), copies[b].end());
+    }
+}
+
+//
+// coalesce_copies(symt,code)
+//
+// Leaving SSA form leaves behind MOVs between variables that are
+// never live at the same time. Give these the same name, so that the
+// MOV can be dropped. This is done by comparing their live intervals
+// over the laid out code, like `allocate_registers` does.
+//
+void coalesce_copies(SymT& symt, INST_vec& code) {
+    std::unordered_map<Symb,std::pair<int,int>> span = Live{code}.spans();
+
+    std::unordered_map<Symb,Symb> alias { };
+    auto named = [&](Symb nm) {
+        while (alias.count(nm) > 0) {
+            nm = alias.at(nm);
+        }
+        return nm;
+    };
+    auto coalescable = [&](Symb nm) {
+        return symt.has_info(nm) && symt.get_info(nm)->kind != FRML;
+    };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        MOV* mov = dynamic_cast<MOV*>(code[i]);
+        if (mov == nullptr) {
+            continue;
+        }
+        Symb dst = named(mov->dst);
+        Symb src = named(mov->src);
+        int at = i;
+        if (dst == src || !coalescable(dst) || !coalescable(src)
+            || symt.get_info(dst)->type != symt.get_info(src)->type
+            || span.at(src).second != at || span.at(dst).first != at) {
+            continue;
+        }
+        alias[src] = dst;
+        span[dst].first = span.at(src).first;
+    }
+
+    INST_vec kept { };
+    for (INST_ptr inst : code) {
+        std::vector<Symb> srcs = inst->srcs();
+        for (Symb& nm : srcs) {
+            nm = named(nm);
+        }
+        inst->set_srcs(srcs);
+        std::vector<Symb> dsts = inst->dsts();
+        for (Symb& nm : dsts) {
+            nm = named(nm);
+        }
+        inst->set_dsts(dsts);
+        MOV* mov = dynamic_cast<MOV*>(inst);
+        if (mov == nullptr || mov->dst != mov->src) {
+            kept.push_back(inst);
+        }
+    }
+    code = kept;
+}
+
+// * * * * *
+//
+// The passes. Each works on code in SSA form, and reports whether it
+// changed anything.
+//
+
+//
+// holds(cndn,v1,v2)
+//
+// Whether a BCN with condition `cndn` would branch on `v1` and `v2`.
+// A BCZ's condition is the same but for a trailing "z", with `v2` 0.
+//
+bool holds(std::string cndn, int v1, int v2) {
+    if (cndn == "lt") return v1 < v2;
+    if (cndn == "le") return v1 <= v2;
+    if (cndn == "gt") return v1 > v2;
+    if (cndn == "ge") return v1 >= v2;
+    if (cndn == "eq") return v1 == v2;
+    return v1 != v2;
+}
+
+//
+// propagate_constants(flow)
+//
+// Any ADD, SUB, MOV, or PHI whose operands are all SET to known values
+// becomes a SET itself, as does any BCN or BCZ that becomes a JMP. Sums
+// and differences that would overflow are left alone, since `add` and
+// `sub` trap at run time.
+//
+// This works from a list of the names whose values have just become
+// known, revisiting only the instructions that read them, so that a
+// chain of folds takes one pass. When a branch becomes a JMP, the edge
+// it no longer takes is dropped right away, along with the PHI
+// arguments that came along it, and a block left with no predecessors
+// drops its own edges in turn. The flow graph is relinked once at the
+// end.
+//
+bool propagate_constants(Flow& flow) {
+    std::unordered_map<Symb,int> value { };
+    std::unordered_map<Symb,std::vector<std::pair<int,int>>> uses { };
+    std::unordered_map<Symb,int> label_at { };
+    std::vector<Symb> work { };
+    for (unsigned int b = 0; b < flow.blks.size(); b++) {
+        BBlk& blk = flow.blks[b];
+        if (!blk.live) {
+            continue;
+        }
+        if (!blk.code.empty()) {
+            if (LBL* lbl = dynamic_cast<LBL*>(blk.code.front())) {
+                label_at[lbl->lbl] = b;
+            }
+        }
+        for (unsigned int i = 0; i < blk.code.size(); i++) {
+            INST_ptr inst = blk.code[i];
+            if (SET* set = dynamic_cast<SET*>(inst)) {
+                value[set->dst] = set->val;
+                work.push_back(set->dst);
+            }
+            for (Symb src : inst->srcs()) {
+                uses[src].push_back({b,i});
+            }
+        }
+    }
+    auto known = [&](Symb nm) { return value.count(nm) > 0; };
+    auto fits = [](long long v) { return v >= INT_MIN && v <= INT_MAX; };
+
+    bool changed = false;
+    bool branched = false;
+    std::function<void(int,int)> try_fold;
+
+    // Drop the edge from block `b` to block `s`.
+    //
+    std::function<void(int,int)> drop_edge = [&](int b, int s) {
+        BBlk& succ = flow.blks[s];
+        std::vector<int>::iterator at = std::find(succ.preds.begin(),
+                                                  succ.preds.end(), b);
+        if (at == succ.preds.end()) {
+            return;
+        }
+        succ.preds.erase(at);
+        for (unsigned int i = 0; i < succ.code.size(); i++) {
+            if (PHI* phi = dynamic_cast<PHI*>(succ.code[i])) {
+                for (unsigned int a = 0; a < phi->preds.size(); a++) {
+                    if (phi->preds[a] == b) {
+                        phi->args.erase(phi->args.begin() + a);
+                        phi->preds.erase(phi->preds.begin() + a);
+                        break;
+                    }
+                }
+                try_fold(s,i);
+            }
+        }
+        if (succ.preds.empty() && s != 0) {
+            std::vector<int> succs = succ.succs;
+            succ.succs.clear();
+            for (int t : succs) {
+                drop_edge(s,t);
+            }
+        }
+    };
+
+    // Fold the `i`-th instruction of block `b`, if it can be.
+    //
+    try_fold = [&](int b, int i) {
+        INST_ptr& inst = flow.blks[b].code[i];
+        INST_ptr fold = nullptr;
+        std::optional<Symb> untaken { };
+        if (ADD* add = dynamic_cast<ADD*>(inst)) {
+            if (known(add->src1) && known(add->src2)) {
+                long long v = (long long)value.at(add->src1)
+                            + (long long)value.at(add->src2);
+                if (fits(v)) {
+                    fold = INST_ptr {new SET {add->dst,(int)v}};
+                }
+            }
+        } else if (SUB* sub = dynamic_cast<SUB*>(inst)) {
+            if (known(sub->src1) && known(sub->src2)) {
+                long long v = (long long)value.at(sub->src1)
+                            - (long long)value.at(sub->src2);
+                if (fits(v)) {
+                    fold = INST_ptr {new SET {sub->dst,(int)v}};
+                }
+            }
+        } else if (MOV* mov = dynamic_cast<MOV*>(inst)) {
+            if (known(mov->src)) {
+                fold = INST_ptr {new SET {mov->dst,value.at(mov->src)}};
+            }
+        } else if (PHI* phi = dynamic_cast<PHI*>(inst)) {
+            bool same = !phi->args.empty();
+            for (Symb arg : phi->args) {
+                same = same && known(arg)
+                    && value.at(arg) == value.at(phi->args[0]);
+            }
+            if (same) {
+                fold = INST_ptr {new SET {phi->dst,value.at(phi->args[0])}};
+            }
+        } else if (BCN* bcn = dynamic_cast<BCN*>(inst)) {
+            if (known(bcn->src1) && known(bcn->src2)) {
+                bool taken = holds(bcn->cndn, value.at(bcn->src1),
+                                   value.at(bcn->src2));
+                fold = INST_ptr {new JMP {taken ? bcn->lblt : bcn->lblf}};
+                untaken = taken ? bcn->lblf : bcn->lblt;
+            }
+        } else if (BCZ* bcz = dynamic_cast<BCZ*>(inst)) {
+            if (known(bcz->src)) {
+                std::string cndn = bcz->cndn.substr(0,bcz->cndn.size()-1);
+                bool taken = holds(cndn, value.at(bcz->src), 0);
+                fold = INST_ptr {new JMP {taken ? bcz->lblt : bcz->lblf}};
+                untaken = taken ? bcz->lblf : bcz->lblt;
+            }
+        }
+        if (fold == nullptr) {
+            return;
+        }
+        inst = fold;
+        changed = true;
+        if (SET* set = dynamic_cast<SET*>(fold)) {
+            value[set->dst] = set->val;
+            work.push_back(set->dst);
+        }
+        if (untaken.has_value()) {
+            branched = true;
+            Symb target = fold->targets()[0];
+            if (*untaken != target && label_at.count(*untaken) > 0) {
+                int s = label_at.at(*untaken);
+                std::vector<int>& succs = flow.blks[b].succs;
+                succs.erase(std::remove(succs.begin(), succs.end(), s),
+                            succs.end());
+                drop_edge(b,s);
+            }
+        }
+    };
+
+    while (!work.empty()) {
+        Symb nm = work.back();
+        work.pop_back();
+        if (uses.count(nm) > 0) {
+            for (std::pair<int,int> use : uses.at(nm)) {
+                try_fold(use.first,use.second);
+            }
+        }
+    }
+    if (branched) {
+        flow.link();
+    }
+    return changed;
+}
+
+//
+// propagate_copies(flow)
+//
+// Drop each `MOV d,s`, reading `s` wherever `d` was read. A PHI whose
+// arguments are all the same (apart from its own result) is a copy
+// too.
+//
+bool propagate_copies(Flow& flow) {
+    std::unordered_map<Symb,Symb> copy_of { };
+    for (BBlk& blk : flow.blks) {
+        if (!blk.live) {
+            continue;
+        }
+        INST_vec kept { };
+        for (INST_ptr inst : blk.code) {
+            if (MOV* mov = dynamic_cast<MOV*>(inst)) {
+                copy_of[mov->dst] = mov->src;
+                continue;
+            }
+            if (PHI* phi = dynamic_cast<PHI*>(inst)) {
+                Symb only = "";
+                bool copy = true;
+                for (Symb arg : phi->args) {
+                    if (arg == phi->dst || arg == only) {
+                        continue;
+                    }
+                    copy = copy && only == "";
+                    only = arg;
+                }
+                if (copy && only != "") {
+                    copy_of[phi->dst] = only;
+                    continue;
+                }
+            }
+            kept.push_back(inst);
+        }
+        blk.code = kept;
+    }
+    if (copy_of.empty()) {
+        return false;
+    }
+    auto source = [&](Symb nm) {
+        for (unsigned int n = 0; copy_of.count(nm) > 0 && n <= copy_of.size(); n++) {
+            nm = copy_of.at(nm);
+        }
+        return nm;
+    };
+    for (BBlk& blk : flow.blks) {
+        for (INST_ptr inst : blk.code) {
+            std::vector<Symb> srcs = inst->srcs();
+            for (Symb& nm : srcs) {
+                nm = source(nm);
+            }
+            inst->set_srcs(srcs);
+        }
+    }
+    return true;
+}
+
+//
+// eliminate_common(flow)
+//
+// Walk down the dominator tree, remembering the ADDs, SUBs, and STLs
+// seen along the way. One that repeats a computation made by a block
+// above it (or earlier in the same block) becomes a MOV of that
+// computation's result.
+//
+bool eliminate_common(Flow& flow) {
+    bool changed = false;
+    std::unordered_map<std::string,Symb> computed { };
+    std::vector<std::vector<std::string>> added (flow.blks.size());
+    auto enter = [&](int b) {
+        for (INST_ptr& inst : flow.blks[b].code) {
+            std::string key = "";
+            if (ADD* add = dynamic_cast<ADD*>(inst)) {
+                key = "add " + std::to_string(std::min(add->src1,add->src2).id)
+                    + "," + std::to_string(std::max(add->src1,add->src2).id);
+            } else if (SUB* sub = dynamic_cast<SUB*>(inst)) {
+                key = "sub " + std::to_string(sub->src1.id)
+                    + "," + std::to_string(sub->src2.id);
+            } else if (STL* stl = dynamic_cast<STL*>(inst)) {
+                key = "stl " + std::to_string(stl->lbl.id);
+            }
+            if (key == "") {
+                continue;
+            }
+            Symb dst = inst->dsts()[0];
+            if (computed.count(key) > 0) {
+                inst = INST_ptr {new MOV {dst,computed.at(key)}};
+                changed = true;
+            } else {
+                computed[key] = dst;
+                added[b].push_back(key);
+            }
+        }
+    };
+    auto leave = [&](int b) {
+        for (std::string key : added[b]) {
+            computed.erase(key);
+        }
+    };
+    flow.walk(enter,leave);
+    return changed;
+}
+
+//
+// eliminate_dead(flow)
+//
+// Remove NOPs, and the SETs, STLs, MOVs, ADDs, SUBs and PHIs whose
+// results are never read. Doing so can leave others unread, so this
+// repeats until there are none.
+//
+bool eliminate_dead(Flow& flow) {
+    bool changed = false;
+    bool again = true;
+    while (again) {
+        again = false;
+        std::unordered_map<Symb,int> uses { };
+        for (BBlk& blk : flow.blks) {
+            if (!blk.live) {
+                continue;
+            }
+            for (INST_ptr inst : blk.code) {
+                std::vector<Symb> dsts = inst->dsts();
+                for (Symb nm : inst->srcs()) {
+                    if (std::find(dsts.begin(), dsts.end(), nm) == dsts.end()) {
+                        uses[nm]++;
+                    }
+                }
+            }
+        }
+        for (BBlk& blk : flow.blks) {
+            if (!blk.live) {
+                continue;
+            }
+            INST_vec kept { };
+            for (INST_ptr inst : blk.code) {
+                INST* i = inst;
+                bool pure = dynamic_cast<NOP*>(i) || dynamic_cast<SET*>(i)
+                    || dynamic_cast<STL*>(i) || dynamic_cast<MOV*>(i)
+                    || dynamic_cast<ADD*>(i) || dynamic_cast<SUB*>(i)
+                    || dynamic_cast<PHI*>(i);
+                bool read = false;
+                for (Symb nm : inst->dsts()) {
+                    read = read || uses[nm] > 0;
+                }
+                if (pure && !read) {
+                    again = true;
+                } else {
+                    kept.push_back(inst);
+                }
+            }
+            blk.code = kept;
+        }
+        changed = changed || again;
+    }
+    return changed;
+}
+
+//
+// hoist_invariants(flow,symt)
+//
+// Find each natural loop, namely a header block `h` along with the
+// blocks that can reach a jump back to `h` without going through it.
+// An instruction of the loop that computes the same value each time
+// around is moved into a preheader, a block that runs just once before
+// the loop is entered. In SSA form, that's a SET, STL, or MOV, or an
+// ADD or SUB, whose sources are all written outside the loop (or by
+// instructions already moved out).
+//
+// Since an ADD or SUB can trap on overflow, it is only moved out from
+// a block that runs on every trip through the loop, i.e. one that
+// dominates every block the loop can be left from.
+//
+// The preheader is the one block entering `h` from outside the loop,
+// if that block leads only to `h`. Otherwise a new block is made for
+// it, laid out last and ending with a jump to `h`. Loops entered from
+// more than one block outside are left alone.
+//
+bool hoist_invariants(Flow& flow, SymT& symt) {
+    std::vector<BBlk>& blks = flow.blks;
+    bool changed = false;
+    for (unsigned int h = 1; h < blks.size(); h++) {
+        if (!blks[h].live) {
+            continue;
+        }
+
+        // Gather the loop's blocks, working back from each back edge.
+        //
+        std::vector<bool> in_loop (blks.size(), false);
+        std::vector<int> work { };
+        for (int p : blks[h].preds) {
+            if (flow.dominates(h,p)) {
+                work.push_back(p);
+            }
+        }
+        if (work.empty()) {
+            continue;
+        }
+        in_loop[h] = true;
+        while (!work.empty()) {
+            int b = work.back();
+            work.pop_back();
+            if (in_loop[b]) {
+                continue;
+            }
+            in_loop[b] = true;
+            for (int p : blks[b].preds) {
+                work.push_back(p);
+            }
+        }
+        std::vector<int> outside { };
+        for (int p : blks[h].preds) {
+            if (!in_loop[p]) {
+                outside.push_back(p);
+            }
+        }
+        if (outside.size() != 1) {
+            continue;
+        }
+        std::vector<int> exits { };
+        for (unsigned int b = 0; b < blks.size(); b++) {
+            if (!in_loop[b]) {
+                continue;
+            }
+            for (int s : blks[b].succs) {
+                if (!in_loop[s]) {
+                    exits.push_back(b);
+                }
+            }
+        }
+
+        // Find the invariant instructions, in the order they run.
+        //
+        std::unordered_map<Symb,bool> varies { };
+        for (unsigned int b = 0; b < blks.size(); b++) {
+            if (in_loop[b]) {
+                for (INST_ptr inst : blks[b].code) {
+                    for (Symb nm : inst->dsts()) {
+                        varies[nm] = true;
+                    }
+                }
+            }
+        }
+        std::vector<int> order { };
+        flow.walk([&](int b) { if (in_loop[b]) order.push_back(b); },
+                  [](int) { });
+        INST_vec hoisted { };
+        for (int b : order) {
+            bool every_trip = true;
+            for (int e : exits) {
+                every_trip = every_trip && flow.dominates(b,e);
+            }
+            INST_vec kept { };
+            for (INST_ptr inst : blks[b].code) {
+                INST* i = inst;
+                bool safe = dynamic_cast<SET*>(i) || dynamic_cast<STL*>(i)
+                    || dynamic_cast<MOV*>(i);
+                bool trap = dynamic_cast<ADD*>(i) || dynamic_cast<SUB*>(i);
+                bool invariant = safe || (trap && every_trip);
+                for (Symb nm : inst->srcs()) {
+                    invariant = invariant && !varies[nm];
+                }
+                if (invariant) {
+                    for (Symb nm : inst->dsts()) {
+                        varies[nm] = false;
+                    }
+                    hoisted.push_back(inst);
+                } else {
+                    kept.push_back(inst);
+                }
+            }
+            blks[b].code = kept;
+        }
+        if (hoisted.empty()) {
+            continue;
+        }
+
+        // Find or make the preheader.
+        //
+        int pre = outside[0];
+        if (blks[pre].succs.size() != 1) {
+            Symb hlbl = dynamic_cast<LBL*>(blks[h].code.front())->lbl;
+            Symb plbl { symt.add_labl() };
+            INST_ptr last = blks[pre].code.back();
+            if (last->targets().empty()) {
+                blks[pre].code.push_back(INST_ptr {new JMP {plbl}});
+            } else {
+                std::vector<Symb> lbls = last->targets();
+                for (Symb& lbl : lbls) {
+                    lbl = (lbl == hlbl) ? plbl : lbl;
+                }
+                last->set_targets(lbls);
+            }
+            for (INST_ptr inst : blks[h].code) {
+                if (PHI* phi = dynamic_cast<PHI*>(inst)) {
+                    for (int& p : phi->preds) {
+                        p = (p == pre) ? (int)blks.size() : p;
+                    }
+                }
+            }
+            pre = blks.size();
+            blks.push_back(BBlk { });
+            blks[pre].code = {INST_ptr {new LBL {plbl}}, INST_ptr {new JMP {hlbl}}};
+        }
+
+        // Put the instructions at its end, but before any jump.
+        //
+        INST_vec& code = blks[pre].code;
+        INST_vec::iterator at = code.end();
+        if (!code.empty()
+            && (!code.back()->falls() || !code.back()->targets().empty())) {
+            at--;
+        }
+        code.insert(at, hoisted.begin(), hoisted.end());
+        flow.link();
+        changed = true;
+    }
+    return changed;
+}
+
+// * * * * *
+//
+// optimize(symt,code,opts)
+//
+// The pass manager. The passes are run in turn, over and over, until
+// a whole round of them changes nothing.
+//
+void optimize(SymT& symt, INST_vec& code, const Opts& opts) {
+    if (!opts.any() || code.empty()) {
+        return;
+    }
+    Flow flow { code };
+    to_ssa(flow,symt);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        if (opts.cnst_prop) {
+            changed = propagate_constants(flow) || changed;
+        }
+        if (opts.copy_prop) {
+            changed = propagate_copies(flow) || changed;
+        }
+        if (opts.cse) {
+            changed = eliminate_common(flow) || changed;
+        }
+        if (opts.dce) {
+            changed = eliminate_dead(flow) || changed;
+        }
+        if (opts.licm) {
+            changed = hoist_invariants(flow,symt) || changed;
+        }
+    }
+    from_ssa(flow,symt);
+    code = flow.layout();
+    coalesce_copies(symt,code);
+}
@@ -0,0 +1,72 @@
+#ifndef _DWISLPY_OPT_HH
+#define _DWISLPY_OPT_HH
+
+//
+// dwislpy-opt.hh
+//
+// The optimizer for the IR of a DwiSlpy program. It runs after
+// `Prgm::trans` and before register allocation, rewriting the code of
+// each `def` (and of the `main` script) in place.
+//
+// The code is split into basic blocks to form its control flow graph,
+// which is then put into static single assignment (SSA) form so that
+// every variable is written by just one instruction. These passes are
+// then run over it until none of them has anything left to do:
+//
+//  * constant propagation - folds the ADD, SUB, and MOV of known values
+//    into SET, and branches on known values into JMP.
+//  * copy propagation - replaces the uses of the destination of a MOV
+//    with its source, so that the MOVs made by `Lkup::trans` go away.
+//  * common subexpression elimination - reuses the result of an earlier
+//    ADD, SUB, or STL of the same operands.
+//  * dead code elimination - removes the instructions whose results
+//    are never used.
+//  * loop-invariant code motion - moves the instructions of a loop
+//    that compute the same value on every trip around it to just
+//    before the loop.
+//
+// Finally the code is taken back out of SSA form and laid out again
+// as an `INST_vec`. Code that can't be reached is always dropped.
+//
+
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+
+//
+// class Opts
+//
+// Which of the optimizer's passes get run. They are all on unless
+// switched off from the `dwislpyc` command line. Along with the passes
+// over the IR, this says whether constants get folded by `Prgm::fold`
+// before translation, whether self tail calls get turned into loops
+// and small `def`s get inlined by `dwislpy-inln.hh` beforehand, and
+// whether the MIPS code gets cleaned up by the peephole optimizer of
+// `dwislpy-peep.hh` afterwards. The method `any` tells whether any of
+// the IR passes are on.
+//
+class Opts {
+public:
+    bool fold = true;
+    bool tail_calls = true;
+    bool inln = true;
+    bool cnst_prop = true;
+    bool copy_prop = true;
+    bool cse = true;
+    bool dce = true;
+    bool licm = true;
+    bool peephole = true;
+    bool any(void) const {
+        return cnst_prop || copy_prop || cse || dce || licm;
+    }
+};
+
+//
+// optimize(symt,code,opts)
+//
+// Run the passes chosen by `opts` over `code`, whose variables are
+// described by `symt`. Any variables introduced along the way are
+// added to `symt` as temporaries.
+//
+void optimize(SymT& symt, INST_vec& code, const Opts& opts);
+
+#endif
@@ -0,0 +1,435 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "dwislpy-peep.hh"
+
+//
+// dwislpy-peep.cc
+//
+// This gives the reading and writing of MIPS assembly lines and the
+// peephole optimizer described in `dwislpy-peep.hh`.
+//
+// The rewrites rely on the way `toMIPS` uses registers. In particular,
+// the scratch registers $t0-$t2 only ever carry a value from one
+// instruction to the next within the code for a single pseudo-
+// instruction, and so they are never live across a label or a jump.
+//
+
+const std::vector<std::string> SCRATCH_REGS { "$t0", "$t1", "$t2" };
+
+// * * * * *
+//
+// read_mips(is), write_mips(os,code)
+//
+
+Mips_vec read_mips(std::istream& is) {
+    Mips_vec code { };
+    std::string line;
+    while (std::getline(is,line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos) {
+            continue;
+        }
+        std::string body = line.substr(start);
+        Mips mips { };
+        if (body[0] == '#' || body[0] == '.') {
+            mips.text = line;
+        } else if (body.back() == ':') {
+            mips.labl = body.substr(0, body.size()-1);
+        } else {
+            size_t space = body.find_first_of(" \t");
+            mips.oper = body.substr(0,space);
+            if (space != std::string::npos) {
+                std::stringstream rest { body.substr(space) };
+                std::string arg;
+                while (std::getline(rest,arg,',')) {
+                    size_t b = arg.find_first_not_of(" \t");
+                    size_t e = arg.find_last_not_of(" \t");
+                    mips.args.push_back(arg.substr(b, e-b+1));
+                }
+            }
+        }
+        code.push_back(mips);
+    }
+    return code;
+}
+
+void write_mips(std::ostream& os, const Mips_vec& code) {
+    for (const Mips& mips : code) {
+        if (mips.is_labl()) {
+            os << mips.labl << ":" << std::endl;
+        } else if (mips.is_inst()) {
+            os << "\t" << mips.oper;
+            for (unsigned int i = 0; i < mips.args.size(); i++) {
+                os << (i == 0 ? " " : ",") << mips.args[i];
+            }
+            os << std::endl;
+        } else {
+            os << mips.text << std::endl;
+        }
+    }
+}
+
+// * * * * *
+//
+// Facts about instructions.
+//
+// * is_branch(m) - whether it is a conditional branch.
+// * is_barrier(m) - whether it is a label or transfers control, ending
+//       a run of code that is executed straight through.
+// * written(m) - the register it writes, or "".
+// * read(m) - the registers it reads.
+//
+
+bool is_branch(const Mips& mips) {
+    return mips.is_inst() && mips.oper[0] == 'b';
+}
+
+bool is_jump(const Mips& mips) {
+    return mips.is_inst() && mips.oper == "j";
+}
+
+bool is_barrier(const Mips& mips) {
+    return mips.is_labl() || is_branch(mips) || is_jump(mips)
+        || mips.oper == "jr" || mips.oper == "jal";
+}
+
+std::string written(const Mips& mips) {
+    if (!mips.is_inst() || mips.args.empty() || mips.oper == "sw"
+        || is_barrier(mips)) {
+        return "";
+    }
+    if (mips.oper == "syscall") {
+        return "$v0";
+    }
+    return mips.args[0];
+}
+
+std::vector<std::string> registers_of(std::string arg) {
+    std::vector<std::string> regs { };
+    size_t at = arg.find('$');
+    while (at != std::string::npos) {
+        size_t end = arg.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789", at+1);
+        regs.push_back(arg.substr(at, end-at));
+        at = arg.find('$', at+1);
+    }
+    return regs;
+}
+
+std::vector<std::string> read(const Mips& mips) {
+    if (mips.oper == "syscall") {
+        return {"$v0", "$a0", "$a1", "$a2"};
+    }
+    if (mips.oper == "jal") {
+        return {"$a0", "$a1", "$a2", "$a3"};
+    }
+    unsigned int first = 1;
+    unsigned int last = mips.args.size();
+    if (mips.oper == "sw" || mips.oper == "jr" || is_branch(mips)) {
+        first = 0;
+    }
+    if (is_branch(mips)) {
+        last--;
+    }
+    std::vector<std::string> regs { };
+    for (unsigned int i = first; i < last; i++) {
+        for (std::string reg : registers_of(mips.args[i])) {
+            regs.push_back(reg);
+        }
+    }
+    return regs;
+}
+
+bool reads(const Mips& mips, std::string reg) {
+    for (std::string r : read(mips)) {
+        if (r == reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// next_inst(code,i)
+//
+// The index of the first instruction after `i`, or the size of `code`
+// if there isn't one. Labels passed along the way are collected into
+// `labls`.
+//
+unsigned int next_inst(const Mips_vec& code, unsigned int i,
+                       std::vector<std::string>& labls) {
+    for (i++; i < code.size() && !code[i].is_inst(); i++) {
+        if (code[i].is_labl()) {
+            labls.push_back(code[i].labl);
+        }
+    }
+    return i;
+}
+
+bool among(std::string lbl, const std::vector<std::string>& labls) {
+    for (std::string l : labls) {
+        if (l == lbl) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// * * * * *
+//
+// The rewrites. Each reports whether it changed anything. Lines that
+// get removed are first marked by clearing them to an empty `Mips`,
+// and then swept away by `sweep`.
+//
+
+bool is_gone(const Mips& mips) {
+    return !mips.is_labl() && !mips.is_inst() && mips.text == "";
+}
+
+void sweep(Mips_vec& code) {
+    Mips_vec kept { };
+    for (const Mips& mips : code) {
+        if (!is_gone(mips)) {
+            kept.push_back(mips);
+        }
+    }
+    code = kept;
+}
+
+//
+// thread_jumps(code)
+//
+bool thread_jumps(Mips_vec& code) {
+    std::unordered_map<std::string,unsigned int> label_at { };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        if (code[i].is_labl()) {
+            label_at[code[i].labl] = i;
+        }
+    }
+    bool changed = false;
+    for (Mips& mips : code) {
+        if (!is_jump(mips) && !is_branch(mips)) {
+            continue;
+        }
+        std::string lbl = mips.args.back();
+        for (unsigned int hops = 0; hops < code.size() && label_at.count(lbl) > 0; hops++) {
+            std::vector<std::string> labls { };
+            unsigned int j = next_inst(code, label_at.at(lbl), labls);
+            if (j == code.size() || !is_jump(code[j]) || code[j].args[0] == lbl) {
+                break;
+            }
+            lbl = code[j].args[0];
+        }
+        if (lbl != mips.args.back()) {
+            mips.args.back() = lbl;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+//
+// drop_unreachable(code)
+//
+bool drop_unreachable(Mips_vec& code) {
+    bool changed = false;
+    bool reachable = true;
+    for (Mips& mips : code) {
+        if (mips.is_labl()) {
+            reachable = true;
+        } else if (mips.is_inst()) {
+            if (!reachable) {
+                mips = Mips { };
+                changed = true;
+            } else if (is_jump(mips) || mips.oper == "jr") {
+                reachable = false;
+            }
+        }
+    }
+    sweep(code);
+    return changed;
+}
+
+//
+// drop_jumps_to_next(code)
+//
+const std::unordered_map<std::string,std::string> INVERSE {
+    {"beq","bne"}, {"bne","beq"}, {"blt","bge"}, {"bge","blt"},
+    {"ble","bgt"}, {"bgt","ble"}, {"bltz","bgez"}, {"bgez","bltz"},
+    {"blez","bgtz"}, {"bgtz","blez"}, {"beqz","bnez"}, {"bnez","beqz"}
+};
+
+bool drop_jumps_to_next(Mips_vec& code) {
+    bool changed = false;
+    for (unsigned int i = 0; i < code.size(); i++) {
+        Mips& mips = code[i];
+        if (is_jump(mips)) {
+            std::vector<std::string> labls { };
+            next_inst(code, i, labls);
+            if (among(mips.args[0], labls)) {
+                mips = Mips { };
+                changed = true;
+            }
+        } else if (is_branch(mips)) {
+            std::vector<std::string> skipped { };
+            unsigned int j = next_inst(code, i, skipped);
+            if (among(mips.args.back(), skipped)) {
+                mips = Mips { };
+                changed = true;
+                continue;
+            }
+            if (j == code.size() || !is_jump(code[j]) || !skipped.empty()
+                || INVERSE.count(mips.oper) == 0) {
+                continue;
+            }
+            std::vector<std::string> labls { };
+            next_inst(code, j, labls);
+            if (among(mips.args.back(), labls)) {
+                mips.oper = INVERSE.at(mips.oper);
+                mips.args.back() = code[j].args[0];
+                code[j] = Mips { };
+                changed = true;
+            }
+        }
+    }
+    sweep(code);
+    return changed;
+}
+
+//
+// forward_stores(code)
+//
+// Track which register holds the value of each frame slot, within
+// each run of straight-line code. A slot's entry is forgotten when the
+// register holding it, or the base register of its address, gets
+// written. A store through one base register forgets the slots of the
+// others, since they might be the same memory.
+//
+bool forward_stores(Mips_vec& code) {
+    bool changed = false;
+    std::unordered_map<std::string,std::string> held_in { };
+    auto base_of = [](std::string addr) {
+        size_t paren = addr.find('(');
+        return addr.substr(paren+1, addr.size()-paren-2);
+    };
+    auto forget = [&](std::string reg) {
+        std::unordered_map<std::string,std::string> kept { };
+        for (std::pair<const std::string,std::string>& ar : held_in) {
+            if (ar.second != reg && base_of(ar.first) != reg) {
+                kept.insert(ar);
+            }
+        }
+        held_in = kept;
+    };
+    for (Mips& mips : code) {
+        if (is_barrier(mips)) {
+            held_in.clear();
+        } else if (mips.oper == "sw") {
+            std::string addr = mips.args[1];
+            std::unordered_map<std::string,std::string> kept { };
+            for (std::pair<const std::string,std::string>& ar : held_in) {
+                if (base_of(ar.first) == base_of(addr)) {
+                    kept.insert(ar);
+                }
+            }
+            held_in = kept;
+            held_in[addr] = mips.args[0];
+        } else if (mips.oper == "lw") {
+            std::string reg = mips.args[0];
+            std::string addr = mips.args[1];
+            if (held_in.count(addr) > 0) {
+                std::string from = held_in.at(addr);
+                changed = true;
+                if (from == reg) {
+                    mips = Mips { };
+                    continue;
+                }
+                mips.oper = "move";
+                mips.args = {reg, from};
+            }
+            forget(reg);
+            if (base_of(addr) != reg) {
+                held_in[addr] = reg;
+            }
+        } else if (written(mips) != "") {
+            forget(written(mips));
+        }
+    }
+    sweep(code);
+    return changed;
+}
+
+//
+// coalesce_moves(code)
+//
+bool coalesce_moves(Mips_vec& code) {
+    bool changed = false;
+    auto is_scratch = [](std::string reg) {
+        for (std::string r : SCRATCH_REGS) {
+            if (r == reg) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto dead_after = [&](std::string reg, unsigned int i) {
+        for (unsigned int k = i+1; k < code.size(); k++) {
+            if (reads(code[k],reg)) {
+                return false;
+            }
+            if (is_barrier(code[k]) || written(code[k]) == reg) {
+                return true;
+            }
+        }
+        return true;
+    };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        Mips& mips = code[i];
+        if (mips.oper == "nop") {
+            mips = Mips { };
+            changed = true;
+            continue;
+        }
+        if (mips.oper != "move") {
+            continue;
+        }
+        std::string dst = mips.args[0];
+        std::string src = mips.args[1];
+        if (dst == src) {
+            mips = Mips { };
+            changed = true;
+            continue;
+        }
+        if (i == 0 || !is_scratch(src)) {
+            continue;
+        }
+        Mips& prev = code[i-1];
+        if (written(prev) == src && prev.oper != "syscall"
+            && dead_after(src,i)) {
+            prev.args[0] = dst;
+            mips = Mips { };
+            changed = true;
+        }
+    }
+    sweep(code);
+    return changed;
+}
+
+// * * * * *
+//
+// peephole(code)
+//
+void peephole(Mips_vec& code) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        changed = thread_jumps(code) || changed;
+        changed = drop_unreachable(code) || changed;
+        changed = drop_jumps_to_next(code) || changed;
+        changed = forward_stores(code) || changed;
+        changed = coalesce_moves(code) || changed;
+    }
+}
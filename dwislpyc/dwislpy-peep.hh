@@ -0,0 +1,73 @@
+#ifndef _DWISLPY_PEEP_HH
+#define _DWISLPY_PEEP_HH
+
+//
+// dwislpy-peep.hh
+//
+// A peephole optimizer for the MIPS32 code of a DwiSlpy program.
+//
+// Each `INST::toMIPS` works on its own, and so the code they produce
+// together has some obvious waste. A value is stored to the frame and
+// then loaded right back, a branch is followed by a jump to the very
+// next label, and so on. `Prgm::compile` has `compile_defn` write
+// each function's code to a string, reads it back in as a `Mips_vec`,
+// and cleans it up with `peephole` before it is output.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+//
+// class Mips
+//
+// One line of MIPS32 assembly. It is either
+//
+//  * a label, with `labl` set,
+//  * an instruction, with `oper` set to its name and `args` to its
+//    operands, like "addi" with {"$sp","$sp","-24"}, or
+//  * a comment or directive, held in `text` just as it was read.
+//
+class Mips {
+public:
+    std::string labl;
+    std::string oper;
+    std::vector<std::string> args;
+    std::string text;
+    bool is_labl(void) const { return labl != ""; }
+    bool is_inst(void) const { return oper != ""; }
+};
+
+typedef std::vector<Mips> Mips_vec;
+
+//
+// read_mips(is), write_mips(os,code)
+//
+// Read assembly lines, as written by `toMIPS`, into a `Mips_vec`, and
+// write a `Mips_vec` back out in that same format.
+//
+Mips_vec read_mips(std::istream& is);
+void write_mips(std::ostream& os, const Mips_vec& code);
+
+//
+// peephole(code)
+//
+// Rewrite `code` until none of these apply:
+//
+//  * jump threading - a jump or branch to a `j` goes to where that
+//    `j` goes instead.
+//  * unreachable code - instructions after a `j` or `jr` and before
+//    the next label are dropped.
+//  * branch-to-next elimination - a `j` or branch to the next label is
+//    dropped, and a branch over a `j` to the next label is inverted to
+//    go to the `j`'s target instead.
+//  * store-to-load forwarding - a `lw` of a frame slot whose value is
+//    already in a register becomes a `move` from that register, or
+//    goes away.
+//  * move coalescing - a `move` to itself is dropped, and a value
+//    computed into a scratch register just to be moved elsewhere is
+//    computed there directly. `nop`s are dropped too.
+//
+void peephole(Mips_vec& code);
+
+#endif
@@ -0,0 +1,462 @@
+#include <vector>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+#include "dwislpy-regs.hh"
+
+//
+// dwislpy-regs.cc
+//
+// This gives the liveness analysis of the IR and the linear scan
+// register allocator that relies on it.
+//
+// The MIPS code generated in `dwislpy-mips.cc` uses $t0, $t1, and $t2
+// as scratch registers for loading and storing the variables that
+// live in the stack frame. It also uses $a0-$a3 and $v0 for system
+// calls and for passing arguments and return values. So the allocator
+// hands out the remaining temporary registers $t3-$t9, which are not
+// preserved across calls, and the saved registers $s0-$s7, which are.
+//
+
+const std::vector<std::string> TEMP_REGS {
+    "$t3", "$t4", "$t5", "$t6", "$t7", "$t8", "$t9"
+};
+const std::vector<std::string> SAVE_REGS {
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7"
+};
+
+//
+// Bitset helpers for `Live`. Each `Bits` has a bit for every variable
+// that can be live across the blocks of the code being analyzed.
+//
+static void set_bit(Bits& bits, int k) {
+    bits[k / 64] |= uint64_t{1} << (k % 64);
+}
+
+template<typename F>
+static void each_bit(const Bits& bits, F visit) {
+    for (unsigned int w = 0; w < bits.size(); w++) {
+        uint64_t word = bits[w];
+        while (word != 0) {
+            visit(w * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+}
+
+//
+// Live(code)
+//
+// Split `code` into basic blocks, summarize each by the variables it
+// reads before writing (`used`) and those it writes (`defd`), and then
+// solve the usual backward dataflow equations
+//
+//     live_out[b] = the union of live_in[c] for each successor c of b
+//     live_in[b]  = used[b] + (live_out[b] - defd[b])
+//
+// with a worklist. Only the predecessors of a block whose `live_in`
+// changed are looked at again.
+//
+// Only a variable that some block reads before writing can be live
+// into or out of a block, so only those are given bits. Most
+// temporaries are written and read within one block and never are.
+//
+Live::Live(const INST_vec& code) :
+    code {code}
+{
+    // Find the basic blocks. Each starts at a label or just after a
+    // jump, branch, or return.
+    //
+    std::unordered_map<Symb,int> block_of_label { };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        LBL* lbl = dynamic_cast<LBL*>(code[i]);
+        if (i == 0 || lbl != nullptr
+            || !code[i-1]->falls() || !code[i-1]->targets().empty()) {
+            block_at.push_back(i);
+        }
+        if (lbl != nullptr) {
+            block_of_label[lbl->lbl] = block_at.size() - 1;
+        }
+    }
+    int num_blocks = block_at.size();
+    block_at.push_back(code.size());
+
+    // Number the variables that some block reads before writing.
+    //
+    std::vector<std::vector<int>> exposed (num_blocks);
+    for (int b = 0; b < num_blocks; b++) {
+        Name_set written { };
+        for (int i = block_at[b]; i < block_at[b+1]; i++) {
+            for (Symb src : code[i]->srcs()) {
+                if (written.count(src) > 0) {
+                    continue;
+                }
+                if (bit_of.count(src) == 0) {
+                    bit_of[src] = names.size();
+                    names.push_back(src);
+                }
+                exposed[b].push_back(bit_of.at(src));
+            }
+            for (Symb dst : code[i]->dsts()) {
+                written.insert(dst);
+            }
+        }
+    }
+
+    // Link the blocks and summarize them.
+    //
+    Bits none ((names.size() + 63) / 64, 0);
+    std::vector<std::vector<int>> succs (num_blocks);
+    std::vector<std::vector<int>> preds (num_blocks);
+    std::vector<Bits> used (num_blocks, none);
+    std::vector<Bits> defd (num_blocks, none);
+    for (int b = 0; b < num_blocks; b++) {
+        INST_ptr last = code[block_at[b+1] - 1];
+        if (last->falls() && b+1 < num_blocks) {
+            succs[b].push_back(b+1);
+        }
+        for (Symb lbl : last->targets()) {
+            if (block_of_label.count(lbl) > 0) {
+                succs[b].push_back(block_of_label.at(lbl));
+            }
+        }
+        for (int c : succs[b]) {
+            preds[c].push_back(b);
+        }
+        for (int k : exposed[b]) {
+            set_bit(used[b], k);
+        }
+        for (int i = block_at[b]; i < block_at[b+1]; i++) {
+            for (Symb dst : code[i]->dsts()) {
+                if (bit_of.count(dst) > 0) {
+                    set_bit(defd[b], bit_of.at(dst));
+                }
+            }
+        }
+    }
+
+    // Solve, starting from the last block.
+    //
+    live_in.assign(num_blocks, none);
+    live_out.assign(num_blocks, none);
+    std::vector<int> work { };
+    std::vector<bool> queued (num_blocks, true);
+    for (int b = 0; b < num_blocks; b++) {
+        work.push_back(b);
+    }
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        queued[b] = false;
+        Bits& out = live_out[b];
+        for (int c : succs[b]) {
+            for (unsigned int w = 0; w < out.size(); w++) {
+                out[w] |= live_in[c][w];
+            }
+        }
+        bool changed = false;
+        for (unsigned int w = 0; w < out.size(); w++) {
+            uint64_t in = used[b][w] | (out[w] & ~defd[b][w]);
+            if (in != live_in[b][w]) {
+                live_in[b][w] = in;
+                changed = true;
+            }
+        }
+        if (changed) {
+            for (int p : preds[b]) {
+                if (!queued[p]) {
+                    queued[p] = true;
+                    work.push_back(p);
+                }
+            }
+        }
+    }
+}
+
+//
+// Live::spans()
+//
+// A variable live somewhere within a block is live from the block's
+// start, or from where it is written, up to the block's end, or to
+// where it is last read. So only those points need to be looked at.
+//
+std::unordered_map<Symb,std::pair<int,int>> Live::spans(void) const {
+    std::unordered_map<Symb,std::pair<int,int>> span { };
+    auto extend = [&](Symb nm, int i) {
+        if (span.count(nm) == 0) {
+            span[nm] = {i,i};
+        }
+        span[nm].first = std::min(span[nm].first, i);
+        span[nm].second = std::max(span[nm].second, i);
+    };
+    for (unsigned int b = 0; b < live_in.size(); b++) {
+        each_bit(live_in[b], [&](int k) { extend(names[k], block_at[b]); });
+        each_bit(live_out[b], [&](int k) { extend(names[k], block_at[b+1] - 1); });
+        for (int i = block_at[b]; i < block_at[b+1]; i++) {
+            for (Symb nm : code[i]->srcs()) extend(nm,i);
+            for (Symb nm : code[i]->dsts()) extend(nm,i);
+        }
+    }
+    return span;
+}
+
+//
+// Live::live_across_calls()
+//
+// Walk back through each block that makes a call to find what is live
+// just after it.
+//
+Name_set Live::live_across_calls(void) const {
+    Name_set across { };
+    for (unsigned int b = 0; b < live_in.size(); b++) {
+        bool calls = false;
+        for (int i = block_at[b]; i < block_at[b+1]; i++) {
+            calls = calls || code[i]->calls();
+        }
+        if (!calls) {
+            continue;
+        }
+        Name_set live { };
+        each_bit(live_out[b], [&](int k) { live.insert(names[k]); });
+        for (int i = block_at[b+1] - 1; i >= block_at[b]; i--) {
+            if (code[i]->calls()) {
+                across.insert(live.begin(), live.end());
+            }
+            for (Symb dst : code[i]->dsts()) {
+                live.erase(dst);
+            }
+            for (Symb src : code[i]->srcs()) {
+                live.insert(src);
+            }
+        }
+    }
+    return across;
+}
+
+//
+// class Interval
+//
+// The span of instructions over which a variable is live, given by the
+// indices of the first and last instructions where it is live (or
+// written). A variable that is live across a call can only be placed
+// in a saved register.
+//
+class Interval {
+public:
+    Symb name;
+    int start;
+    int end;
+    bool across_call;
+    std::string reg;
+};
+
+//
+// live_intervals(symt,code)
+//
+// Build the live interval of each variable of `symt` used by `code`.
+//
+std::unordered_map<Symb,Interval> live_intervals(const SymT& symt,
+                                                        const INST_vec& code) {
+    Live live { code };
+    std::unordered_map<Symb,Interval> intervals { };
+    for (std::pair<const Symb,std::pair<int,int>>& nmsp : live.spans()) {
+        Symb nm = nmsp.first;
+        if (symt.has_info(nm)) {
+            intervals[nm] = Interval {nm, nmsp.second.first, nmsp.second.second,
+                                      false, ""};
+        }
+    }
+    for (Symb nm : live.live_across_calls()) {
+        if (intervals.count(nm) > 0) {
+            intervals.at(nm).across_call = true;
+        }
+    }
+    return intervals;
+}
+
+//
+// by_start(intervals)
+//
+// Give pointers to the intervals sorted by their start.
+//
+std::vector<Interval*> by_start(std::unordered_map<Symb,Interval>& intervals) {
+    std::vector<Interval*> order { };
+    for (std::pair<const Symb,Interval>& nmiv : intervals) {
+        order.push_back(&nmiv.second);
+    }
+    std::sort(order.begin(), order.end(), [](Interval* a, Interval* b) {
+        if (a->start != b->start) {
+            return a->start < b->start;
+        }
+        return a->name < b->name;
+    });
+    return order;
+}
+
+//
+// is_leaf(code)
+//
+bool is_leaf(const INST_vec& code) {
+    for (INST_ptr inst : code) {
+        if (inst->calls()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// allocate_registers(symt,code)
+//
+// A linear scan allocator. The variables' live intervals are visited
+// in order of their start. Each is given a free register, if there is
+// one. If not, the interval that ends last among it and the intervals
+// holding registers gets spilled, i.e. left in the stack frame.
+//
+// In a leaf, nothing else writes $a0-$a3 except for the printing
+// instructions, which load what they print into $a0. So each formal
+// other than that one just stays in the register it was passed in.
+//
+void allocate_registers(SymT& symt, const INST_vec& code) {
+    std::unordered_map<Symb,Interval> intervals = live_intervals(symt,code);
+
+    // Leave the formals of a leaf in $a0-$a3.
+    //
+    bool leaf = is_leaf(code);
+    symt.set_leaf(leaf);
+    if (leaf) {
+        bool prints = false;
+        for (INST_ptr inst : code) {
+            if (dynamic_cast<PTI*>(inst) != nullptr
+                || dynamic_cast<PTS*>(inst) != nullptr) {
+                prints = true;
+            }
+        }
+        for (unsigned int i = 0; i < symt.get_frmls_size() && i < 4; i++) {
+            Symb frml { symt.get_frml(i)->name };
+            if (i == 0 && prints) {
+                continue;
+            }
+            symt.set_register(frml, "$a" + std::to_string(i));
+            intervals.erase(frml);
+        }
+    }
+
+    // Visit the rest in order of their start.
+    //
+    std::vector<Interval*> order = by_start(intervals);
+
+    std::set<std::string> free_temps { TEMP_REGS.begin(), TEMP_REGS.end() };
+    std::set<std::string> free_saves { SAVE_REGS.begin(), SAVE_REGS.end() };
+    std::set<std::string> used_saves { };
+    std::vector<Interval*> active { };
+
+    for (Interval* iv : order) {
+
+        // Free the registers of intervals that have ended.
+        //
+        std::vector<Interval*> still_active { };
+        for (Interval* act : active) {
+            if (act->end < iv->start) {
+                if (act->reg[1] == 's') {
+                    free_saves.insert(act->reg);
+                } else {
+                    free_temps.insert(act->reg);
+                }
+            } else {
+                still_active.push_back(act);
+            }
+        }
+        active = still_active;
+
+        // Take a free register, or spill.
+        //
+        if (!iv->across_call && !free_temps.empty()) {
+            iv->reg = *free_temps.begin();
+            free_temps.erase(free_temps.begin());
+        } else if (!free_saves.empty()) {
+            iv->reg = *free_saves.begin();
+            free_saves.erase(free_saves.begin());
+        } else {
+            Interval* spill = nullptr;
+            for (Interval* act : active) {
+                if (iv->across_call && act->reg[1] != 's') {
+                    continue;
+                }
+                if (spill == nullptr || act->end > spill->end) {
+                    spill = act;
+                }
+            }
+            if (spill == nullptr || spill->end <= iv->end) {
+                continue;
+            }
+            iv->reg = spill->reg;
+            spill->reg = "";
+            active.erase(std::find(active.begin(), active.end(), spill));
+        }
+        active.push_back(iv);
+        if (iv->reg[1] == 's') {
+            used_saves.insert(iv->reg);
+        }
+    }
+
+    // Record the allocation.
+    //
+    for (std::pair<const Symb,Interval>& nmiv : intervals) {
+        if (nmiv.second.reg != "") {
+            symt.set_register(nmiv.first, nmiv.second.reg);
+        }
+    }
+    for (std::string reg : used_saves) {
+        symt.add_saved(reg);
+    }
+}
+
+//
+// share_frame_slots(symt,code)
+//
+// Give each local and temporary of `symt` that lives in the stack frame
+// a slot index, recording it with `SymT::set_frame_slot`. Variables
+// whose live intervals don't overlap share a slot. This is again a
+// linear scan, but one that never runs out of slots.
+//
+void share_frame_slots(SymT& symt, const INST_vec& code) {
+    std::unordered_map<Symb,Interval> intervals = live_intervals(symt,code);
+    std::set<int> free_slots { };
+    int num_slots = 0;
+    std::vector<Interval*> active { };
+    for (Interval* iv : by_start(intervals)) {
+        if (symt.get_info(iv->name)->kind == FRML
+            || symt.has_register(iv->name)) {
+            continue;
+        }
+
+        // Free the slots of intervals that have ended.
+        //
+        std::vector<Interval*> still_active { };
+        for (Interval* act : active) {
+            if (act->end < iv->start) {
+                free_slots.insert(symt.get_frame_slot(act->name));
+            } else {
+                still_active.push_back(act);
+            }
+        }
+        active = still_active;
+
+        // Take a free slot, or make a new one.
+        //
+        int slot;
+        if (!free_slots.empty()) {
+            slot = *free_slots.begin();
+            free_slots.erase(free_slots.begin());
+        } else {
+            slot = num_slots++;
+        }
+        symt.set_frame_slot(iv->name,slot);
+        active.push_back(iv);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef _DWISLPY_REGS_HH
+#define _DWISLPY_REGS_HH
+
+//
+// dwislpy-regs.hh
+//
+// Liveness analysis and register allocation for the IR of a DwiSlpy
+// program.
+//
+// Without register allocation, every variable and temporary of a
+// `def` (or of the `main` script) gets a slot in its stack frame, and
+// the MIPS code for each pseudo-instruction loads its operands from
+// the frame and stores its result back. The allocator runs after
+// `Prgm::trans` and before `compile_defn`, and assigns MIPS registers
+// to as many of them as it can so that `toMIPS` can operate on
+// registers directly. The rest then share frame slots wherever their
+// lifetimes allow.
+//
+
+#include <vector>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+
+typedef std::set<Symb> Name_set;
+typedef std::vector<uint64_t> Bits;
+
+//
+// class Live
+//
+// The result of a liveness analysis of a sequence of IR instructions.
+// A variable is live at a point in the code if its value there might
+// be read later on.
+//
+// The analysis is done on the basic blocks of the code, with the sets
+// of variables live into and out of each block kept as bitsets. The
+// variables that can be live across blocks are numbered, and `names`
+// gives the `Symb` for each bit. Facts about single
+// instructions are derived from these when asked for:
+//
+//  * spans() gives, for each variable, the first and last instruction
+//    where it is live (or written), and
+//  * live_across_calls() gives the variables live just after some
+//    instruction that makes a call.
+//
+// A `Live` refers to the code it was built from, which must outlive it.
+//
+class Live {
+public:
+    Live(const INST_vec& code);
+    std::unordered_map<Symb,std::pair<int,int>> spans(void) const;
+    Name_set live_across_calls(void) const;
+private:
+    const INST_vec& code;
+    std::vector<Symb> names;              // Indexed by bit.
+    std::unordered_map<Symb,int> bit_of;
+    std::vector<int> block_at;            // Block starts, then code.size().
+    std::vector<Bits> live_in;            // Indexed by block.
+    std::vector<Bits> live_out;
+};
+
+//
+// is_leaf(code)
+//
+// Whether `code` makes no calls. The `def` it belongs to is then a
+// "leaf" of the call graph.
+//
+bool is_leaf(const INST_vec& code);
+
+//
+// allocate_registers(symt,code)
+//
+// Assign MIPS registers to the formals, locals, and temporaries of
+// `symt` used by `code`, recording them with `SymT::set_register`.
+// Those that don't get a register stay in the stack frame. Any
+// callee-saved registers that get used are recorded with
+// `SymT::add_saved` so they can be saved and restored.
+//
+// Whether `code` is a leaf is recorded with `SymT::set_leaf`. A leaf's
+// formals are kept in the argument registers they are passed in,
+// where they can be.
+//
+void allocate_registers(SymT& symt, const INST_vec& code);
+
+//
+// share_frame_slots(symt,code)
+//
+// Number the stack frame slots of the locals and temporaries of `symt`
+// that didn't get a register, recording them with `SymT::set_frame_slot`.
+// Variables that are never live at the same time share a slot. Those
+// not used by `code` at all get no slot.
+//
+void share_frame_slots(SymT& symt, const INST_vec& code);
+
+#endif
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <algorithm>
 #include "dwislpy-util.hh"
 
 //
@@ -104,3 +105,23 @@ none None;
 
 
 
+
+//
+// Arena::allocate(size)
+//
+// Hand out `size` bytes, aligned for any object. A request bigger than
+// a chunk gets a chunk of its own.
+//
+const std::size_t ARENA_CHUNK_SIZE = 1 << 20;
+
+void* Arena::allocate(std::size_t size) {
+    const std::size_t align = alignof(std::max_align_t);
+    size = (size + align - 1) / align * align;
+    if (chunks.empty() || used + size > ARENA_CHUNK_SIZE) {
+        chunks.emplace_back(new char[std::max(size, ARENA_CHUNK_SIZE)]);
+        used = 0;
+    }
+    void* obj = chunks.back().get() + used;
+    used += size;
+    return obj;
+}
@@ -16,6 +16,13 @@
 //
 //   * de_escape, re_escape
 //
+// And `Arena` hands out the memory for objects that live until the
+// compiler exits, namely AST nodes and IR instructions.
+//
+
+#include <cstddef>
+#include <memory>
+#include <vector>
 
 //
 // class Locn
@@ -72,4 +79,21 @@ std::string de_escape(std::string s); // Replace \d sequences with actuals.
 struct none { };
 extern none None;
 
+//
+// class Arena
+//
+// A bump-pointer allocator. It keeps a list of big chunks and fills
+// the last one from front to back, so that objects allocated one
+// after another end up next to each other in memory. Nothing is ever
+// given back. Classes that use one define their own `operator new`
+// with a `static Arena` and a `delete` that does nothing.
+//
+class Arena {
+public:
+    void* allocate(std::size_t size);
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::size_t used = 0;
+};
+
 #endif
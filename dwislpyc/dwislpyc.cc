@@ -11,18 +11,37 @@
 //
 // dwslpyc - a DWISLPY compiler
 //
-// Usage: ./dwislpyc <DWISLPY source file name>
+// Usage: ./dwislpyc [--run | --walk | --bytecode] [-O0] [--no-<pass>]
+//                   <DWISLPY source file name>
 //
 // This command compiles a DWISLPY program into MIPS source. If the
 // source file's name is `foo.py` (or `foo.slpy` etc.) It will
 // generate the MIPS source `foo.s`. This source can be run using the
 // SPIM text-based MIPS32 emulator.
 //
+// With `--run` it instead runs the checked program directly using the
+// bytecode interpreter. With `--walk` it runs it using the (slower)
+// AST-walking interpreter. With `--bytecode` it outputs a listing of
+// the bytecode that `--run` would execute.
+//
+// When compiling, constant expressions are folded (see `Prgm::fold`
+// in `dwislpy-check.cc`), self tail calls become loops and calls to
+// small `def`s are inlined (see `dwislpy-inln.hh`), the IR is optimized
+// (see `dwislpy-opt.hh`), and the MIPS code is cleaned up after (see
+// `dwislpy-peep.hh`). Each of these passes can be switched off with
+// `--no-fold`, `--no-tailcalls`, `--no-inline`, `--no-constprop`,
+// `--no-copyprop`, `--no-cse`, `--no-dce`, `--no-licm`, or
+// `--no-peephole`, and `-O0` switches them all off.
+//
 // The code is heavily reliant upon:
 //
 // * dwislpy-ast.{cc,hh} - defines the AST for our language
 // * dwislpy-check.{cc,hh} - annotates the AST in prep for compilation
 // * dwislpy-inst.{cc,hh} - defines the IR, performs translation/compilation
+// * dwislpy-byte.{cc,hh} - defines the bytecode and its interpreter
+// * dwislpy-inln.{cc,hh} - inlines calls to small functions in the IR
+// * dwislpy-opt.{cc,hh} - optimizes the IR
+// * dwislpy-peep.{cc,hh} - optimizes the MIPS code
 //
 
 // * * * * *
@@ -67,6 +86,22 @@ void DWISLPY::Driver::run(void) {
     program->run();
 }
 
+// walk
+//
+// Runs the DwiSlpy program by walking its AST.
+//
+void DWISLPY::Driver::walk(void) {
+    program->walk();
+}
+
+// dump_bcode
+//
+// Outputs the bytecode of the DwiSlpy program.
+//
+void DWISLPY::Driver::dump_bcode(void) {
+    program->bcode().dump(std::cout);
+}
+
 // check
 //
 // Runs the DwiSlpy program.
@@ -77,14 +112,15 @@ void DWISLPY::Driver::check(void) {
 
 // compile
 //
-// Runs the DwiSlpy program.
+// Compiles the DwiSlpy program to MIPS, running the optimizer passes
+// chosen by `opts`.
 //
-void DWISLPY::Driver::compile(void) {
+void DWISLPY::Driver::compile(const Opts& opts) {
     std::ofstream out_stream { };
     size_t thedot = src_name.find_last_of("."); 
     std::string out_name = src_name.substr(0, thedot) + ".s"; 
     out_stream.open(out_name);
-    program->compile(out_stream);
+    program->compile(out_stream,opts);
     out_stream.close();
 }
 
@@ -108,6 +144,13 @@ char* extract_filename(int argc, char** argv) {
     return nullptr;
 }
 
+bool has_flag(int argc, char** argv, const char* flag) {
+    for (int i=1; i<argc; i++) {
+        if (std::strcmp(argv[i],flag) == 0) return true;
+    }
+    return false;
+}
+
 // * * * * * 
 //
 // main - the DWISLPY interpreter
@@ -136,9 +179,28 @@ int main(int argc, char** argv) {
             dwislpy.check();
             
             //
-            // Compile.
+            // Run, or compile.
             //
-            dwislpy.compile();
+            if (has_flag(argc,argv,"--run")) {
+                dwislpy.run();
+            } else if (has_flag(argc,argv,"--walk")) {
+                dwislpy.walk();
+            } else if (has_flag(argc,argv,"--bytecode")) {
+                dwislpy.dump_bcode();
+            } else {
+                Opts opts { };
+                bool none = has_flag(argc,argv,"-O0");
+                opts.fold = !none && !has_flag(argc,argv,"--no-fold");
+                opts.tail_calls = !none && !has_flag(argc,argv,"--no-tailcalls");
+                opts.inln = !none && !has_flag(argc,argv,"--no-inline");
+                opts.cnst_prop = !none && !has_flag(argc,argv,"--no-constprop");
+                opts.copy_prop = !none && !has_flag(argc,argv,"--no-copyprop");
+                opts.cse = !none && !has_flag(argc,argv,"--no-cse");
+                opts.dce = !none && !has_flag(argc,argv,"--no-dce");
+                opts.licm = !none && !has_flag(argc,argv,"--no-licm");
+                opts.peephole = !none && !has_flag(argc,argv,"--no-peephole");
+                dwislpy.compile(opts);
+            }
             
         } catch (DwislpyError se) {
             
@@ -154,6 +216,7 @@ int main(int argc, char** argv) {
         //
         std::cerr << "usage: "
                   << argv[0]
+                  << " [--run | --walk | --bytecode] [-O0] [--no-<pass>] file"
                   << std::endl;
     }
 }
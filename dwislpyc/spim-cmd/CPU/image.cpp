@@ -0,0 +1,571 @@
+/* SPIM S20 MIPS simulator.
+   Save and restore assembled machine images.
+
+   Copyright (c) 1990-2010, James R. Larus.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation and/or
+   other materials provided with the distribution.
+
+   Neither the name of the James R. Larus nor the names of its contributors may be
+   used to endorse or promote products derived from this software without specific
+   prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+   GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "inst.h"
+#include "reg.h"
+#include "mem.h"
+#include "data.h"
+#include "sym-tbl.h"
+#include "image.h"
+
+
+/* A machine image holds what is needed to run an assembled program
+   without assembling it again: the registers, the contents of the text
+   and data segments, and the symbol table.  It is written after the
+   exception handler and program are loaded and is read back with mmap,
+   which replaces initialize_world and read_assembly_file.
+
+   Instructions are saved as their fields, not their encodings, so they
+   are restored exactly as the assembler left them, including any
+   reference to an undefined symbol.  The file is in the byte order and
+   layout of the host that wrote it.  The header records both: a known
+   word that reads back differently on a host of the other byte order,
+   and the sizes of the records.  A file that does not match is rejected.
+
+   The file contains an image_header, the text and kernel text segments
+   (as image_insts), the data and kernel data segments (up to their last
+   non-zero word), the symbol table (as image_symbols), and a table of
+   the strings that they reference. */
+
+#define IMAGE_MAGIC "SPIMIMG"
+#define IMAGE_VERSION 2
+#define IMAGE_BYTE_ORDER 0x01020304
+
+/* Machine flags: */
+#define IMAGE_BARE_MACHINE	0x1
+#define IMAGE_DELAYED_BRANCHES	0x2
+#define IMAGE_DELAYED_LOADS	0x4
+
+typedef struct image_header
+{
+  char magic [8];
+  int32 version;
+  int32 byte_order;		/* IMAGE_BYTE_ORDER, as written by the host */
+  int32 header_size;		/* Sizes of the records, to check layout */
+  int32 inst_size;
+  int32 symbol_size;
+  int32 flags;			/* IMAGE_BARE_MACHINE, ... */
+
+  reg_word R [R_LENGTH];
+  reg_word HI, LO;
+  mem_addr PC, nPC;
+  double FPR [FPR_LENGTH];
+  reg_word CCR [4][32], CPR [4][32];
+
+  mem_addr text_top, data_top, stack_bot, k_text_top, k_data_top;
+  mem_addr gp_midpoint;
+  mem_addr next_text_pc, next_k_text_pc, next_data_pc, next_k_data_pc;
+
+  int32 text_count;		/* Instructions saved */
+  int32 k_text_count;
+  int32 data_size;		/* Bytes saved */
+  int32 k_data_size;
+  int32 symbol_count;
+  int32 string_size;
+} image_header;
+
+
+/* Instruction flags: */
+#define IMAGE_EXPR		0x1 /* Instruction has an expression */
+#define IMAGE_PC_RELATIVE	0x2 /* Expression is PC-relative */
+#define IMAGE_IN_TABLE		0x4 /* Expression's symbol is in table */
+
+typedef struct image_inst
+{
+  int32 opcode;			/* 0 => no instruction at this address */
+  inst_fields r_t;
+  int32 encoding;
+  int32 source;			/* String offset of source line, or -1 */
+  int32 flags;			/* IMAGE_EXPR, ... */
+  int32 expr_offset;
+  int32 expr_bits;
+  int32 expr_symbol;		/* String offset of symbol name, or -1 */
+  int32 expr_symbol_addr;
+} image_inst;
+
+
+/* Symbol flags: */
+#define IMAGE_GLOBAL		0x1
+#define IMAGE_GP		0x2
+#define IMAGE_CONST		0x4
+
+typedef struct image_symbol
+{
+  int32 name;			/* String offset of name */
+  int32 addr;
+  int32 flags;			/* IMAGE_GLOBAL, ... */
+} image_symbol;
+
+
+/* Tables built while writing an image. */
+
+typedef struct image_tables
+{
+  image_symbol *symbols;
+  int symbol_count, symbol_max;
+  char *strings;
+  int string_size, string_max;
+} image_tables;
+
+
+/* Local functions: */
+
+static int32 add_image_string (image_tables *tables, char *str);
+static void add_image_symbol (label *l, void *arg);
+static void restore_text (instruction **seg, image_inst *insts, int count,
+			  char *strings);
+static void save_text (FILE *fp, instruction **seg, int count,
+		       image_tables *tables);
+static int text_count (instruction **seg, mem_addr bot, mem_addr top);
+static int data_size (BYTE_TYPE *seg, mem_addr bot, mem_addr top);
+
+
+
+/* Write an image of the machine, with the program that has been
+   loaded, to the file FILE_NAME.  Return true if successful and false
+   otherwise. */
+
+bool
+write_machine_image (char *file_name)
+{
+  FILE *fp = fopen (file_name, "wb");
+  image_header header;
+  image_tables tables;
+  bool ok;
+
+  if (fp == NULL)
+    {
+      error ("Cannot open file: `%s'\n", file_name);
+      return (false);
+    }
+
+  memclr (&header, sizeof (header));
+  memclr (&tables, sizeof (tables));
+  strcpy (header.magic, IMAGE_MAGIC);
+  header.version = IMAGE_VERSION;
+  header.byte_order = IMAGE_BYTE_ORDER;
+  header.header_size = sizeof (image_header);
+  header.inst_size = sizeof (image_inst);
+  header.symbol_size = sizeof (image_symbol);
+  header.flags = ((bare_machine ? IMAGE_BARE_MACHINE : 0)
+		  | (delayed_branches ? IMAGE_DELAYED_BRANCHES : 0)
+		  | (delayed_loads ? IMAGE_DELAYED_LOADS : 0));
+
+  memcpy (header.R, R, sizeof (header.R));
+  header.HI = HI;
+  header.LO = LO;
+  header.PC = PC;
+  header.nPC = nPC;
+  memcpy (header.FPR, FPR, sizeof (header.FPR));
+  memcpy (header.CCR, CCR, sizeof (header.CCR));
+  memcpy (header.CPR, CPR, sizeof (header.CPR));
+
+  header.text_top = text_top;
+  header.data_top = data_top;
+  header.stack_bot = stack_bot;
+  header.k_text_top = k_text_top;
+  header.k_data_top = k_data_top;
+  header.gp_midpoint = gp_midpoint;
+
+  /* The assembler's locations, so more files can be loaded later: */
+  user_kernel_text_segment (true);
+  header.next_k_text_pc = current_text_pc ();
+  user_kernel_text_segment (false);
+  header.next_text_pc = current_text_pc ();
+  user_kernel_data_segment (true);
+  header.next_k_data_pc = current_data_pc ();
+  user_kernel_data_segment (false);
+  header.next_data_pc = current_data_pc ();
+
+  header.text_count = text_count (text_seg, TEXT_BOT, text_top);
+  header.k_text_count = text_count (k_text_seg, K_TEXT_BOT, k_text_top);
+  header.data_size = data_size (data_seg_b, DATA_BOT, data_top);
+  header.k_data_size = data_size (k_data_seg_b, K_DATA_BOT, k_data_top);
+
+  /* The header is written again once the tables are complete. */
+  fwrite (&header, sizeof (header), 1, fp);
+  save_text (fp, text_seg, header.text_count, &tables);
+  save_text (fp, k_text_seg, header.k_text_count, &tables);
+  fwrite (data_seg_b, 1, header.data_size, fp);
+  fwrite (k_data_seg_b, 1, header.k_data_size, fp);
+
+  map_labels (add_image_symbol, &tables);
+  fwrite (tables.symbols, sizeof (image_symbol), tables.symbol_count, fp);
+  fwrite (tables.strings, 1, tables.string_size, fp);
+
+  header.symbol_count = tables.symbol_count;
+  header.string_size = tables.string_size;
+  rewind (fp);
+  fwrite (&header, sizeof (header), 1, fp);
+
+  ok = !ferror (fp);
+  if (fclose (fp) != 0)
+    ok = false;
+  if (!ok)
+    error ("Cannot write image: `%s'\n", file_name);
+
+  free (tables.symbols);
+  free (tables.strings);
+  return (ok);
+}
+
+
+/* Return the number of instructions in the text segment SEG, from BOT
+   up to TOP, through the last instruction. */
+
+static int
+text_count (instruction **seg, mem_addr bot, mem_addr top)
+{
+  int n = (top - bot) / BYTES_PER_WORD;
+
+  while (n > 0 && seg[n - 1] == NULL)
+    n -= 1;
+  return (n);
+}
+
+
+/* Return the number of bytes in the data segment SEG, from BOT up to
+   TOP, through the last non-zero word. */
+
+static int
+data_size (BYTE_TYPE *seg, mem_addr bot, mem_addr top)
+{
+  mem_word *words = (mem_word *) seg;
+  int n = (top - bot) / BYTES_PER_WORD;
+
+  while (n > 0 && words[n - 1] == 0)
+    n -= 1;
+  return (n * BYTES_PER_WORD);
+}
+
+
+/* Write the first COUNT instructions in the text segment SEG to FP. */
+
+static void
+save_text (FILE *fp, instruction **seg, int count, image_tables *tables)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      instruction *inst = seg[i];
+      image_inst ii;
+
+      memclr (&ii, sizeof (ii));
+      ii.source = -1;
+      ii.expr_symbol = -1;
+      if (inst != NULL)
+	{
+	  ii.opcode = OPCODE (inst);
+	  ii.r_t = inst->r_t;
+	  ii.encoding = ENCODING (inst);
+	  if (SOURCE (inst) != NULL)
+	    ii.source = add_image_string (tables, SOURCE (inst));
+	  if (EXPR (inst) != NULL)
+	    {
+	      imm_expr *expr = EXPR (inst);
+
+	      ii.flags = IMAGE_EXPR | (expr->pc_relative ? IMAGE_PC_RELATIVE : 0);
+	      ii.expr_offset = expr->offset;
+	      ii.expr_bits = expr->bits;
+	      if (expr->symbol != NULL)
+		{
+		  ii.expr_symbol = add_image_string (tables, expr->symbol->name);
+		  ii.expr_symbol_addr = expr->symbol->addr;
+		  if (label_is_defined (expr->symbol->name) == expr->symbol)
+		    ii.flags |= IMAGE_IN_TABLE;
+		}
+	    }
+	}
+      fwrite (&ii, sizeof (ii), 1, fp);
+    }
+}
+
+
+/* Add the label L to the symbol table being built in ARG. */
+
+static void
+add_image_symbol (label *l, void *arg)
+{
+  image_tables *tables = (image_tables *) arg;
+  image_symbol *sym;
+
+  if (tables->symbol_count == tables->symbol_max)
+    {
+      tables->symbol_max = MAX (256, 2 * tables->symbol_max);
+      tables->symbols = (image_symbol *) realloc (tables->symbols,
+						  tables->symbol_max
+						  * sizeof (image_symbol));
+      if (tables->symbols == NULL)
+	fatal_error ("Out of memory writing image\n");
+    }
+  sym = &tables->symbols[tables->symbol_count++];
+  sym->name = add_image_string (tables, l->name);
+  sym->addr = l->addr;
+  sym->flags = ((l->global_flag ? IMAGE_GLOBAL : 0)
+		| (l->gp_flag ? IMAGE_GP : 0)
+		| (l->const_flag ? IMAGE_CONST : 0));
+}
+
+
+/* Add STR to the string table being built in TABLES and return its
+   offset. */
+
+static int32
+add_image_string (image_tables *tables, char *str)
+{
+  int len = strlen (str) + 1;
+  int32 offset = tables->string_size;
+
+  if (tables->string_size + len > tables->string_max)
+    {
+      tables->string_max = MAX (4 * K, 2 * (tables->string_size + len));
+      tables->strings = (char *) realloc (tables->strings, tables->string_max);
+      if (tables->strings == NULL)
+	fatal_error ("Out of memory writing image\n");
+    }
+  memcpy (tables->strings + offset, str, len);
+  tables->string_size += len;
+  return (offset);
+}
+
+
+/* Return true if the file FILE_NAME starts like a machine image. */
+
+bool
+is_machine_image (char *file_name)
+{
+  FILE *fp = fopen (file_name, "rb");
+  char magic [8];
+  bool is_image;
+
+  if (fp == NULL)
+    return (false);
+  is_image = (fread (magic, 1, sizeof (magic), fp) == sizeof (magic)
+	      && streq (magic, IMAGE_MAGIC));
+  fclose (fp);
+  return (is_image);
+}
+
+
+/* Replace the machine with the image in the file FILE_NAME.  Return
+   true if successful and false otherwise. */
+
+bool
+read_machine_image (char *file_name)
+{
+  int fd = open (file_name, O_RDONLY);
+  struct stat st;
+  char *base;
+  image_header *header;
+  image_inst *text, *k_text;
+  BYTE_TYPE *data, *k_data;
+  image_symbol *symbols;
+  char *strings;
+  int i;
+
+  if (fd < 0 || fstat (fd, &st) < 0)
+    {
+      error ("Cannot open file: `%s'\n", file_name);
+      if (fd >= 0)
+	close (fd);
+      return (false);
+    }
+
+#ifdef _WIN32
+  base = (char *) xmalloc (st.st_size);
+  if (read (fd, base, st.st_size) != st.st_size)
+    {
+      free (base);
+      base = NULL;
+    }
+#else
+  base = (char *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (base == (char *) MAP_FAILED)
+    base = NULL;
+#endif
+  close (fd);
+  if (base == NULL)
+    {
+      error ("Cannot read image: `%s'\n", file_name);
+      return (false);
+    }
+
+  header = (image_header *) base;
+  if ((size_t) st.st_size < sizeof (image_header)
+      || !streq (header->magic, IMAGE_MAGIC)
+      || header->byte_order != IMAGE_BYTE_ORDER
+      || header->version != IMAGE_VERSION
+      || header->header_size != sizeof (image_header)
+      || header->inst_size != sizeof (image_inst)
+      || header->symbol_size != sizeof (image_symbol)
+      || (size_t) st.st_size != (sizeof (image_header)
+				 + (header->text_count + header->k_text_count)
+				 * sizeof (image_inst)
+				 + header->data_size + header->k_data_size
+				 + header->symbol_count * sizeof (image_symbol)
+				 + header->string_size))
+    {
+      error ("Not a SPIM image for this machine: `%s'\n", file_name);
+#ifdef _WIN32
+      free (base);
+#else
+      munmap (base, st.st_size);
+#endif
+      return (false);
+    }
+  text = (image_inst *) (header + 1);
+  k_text = text + header->text_count;
+  data = (BYTE_TYPE *) (k_text + header->k_text_count);
+  k_data = data + header->data_size;
+  symbols = (image_symbol *) (k_data + header->k_data_size);
+  strings = (char *) (symbols + header->symbol_count);
+
+  bare_machine = (header->flags & IMAGE_BARE_MACHINE) != 0;
+  delayed_branches = (header->flags & IMAGE_DELAYED_BRANCHES) != 0;
+  delayed_loads = (header->flags & IMAGE_DELAYED_LOADS) != 0;
+
+  /* Same steps as initialize_world, with the image's segment sizes. */
+  if (FGR == NULL)
+    FPR = (double *) xmalloc (FPR_LENGTH * sizeof (double));
+  make_memory (header->text_top - TEXT_BOT,
+	       header->data_top - DATA_BOT,
+	       MAX (initial_data_limit, header->data_top - DATA_BOT),
+	       STACK_TOP - header->stack_bot,
+	       MAX (initial_stack_limit, STACK_TOP - header->stack_bot),
+	       header->k_text_top - K_TEXT_BOT,
+	       header->k_data_top - K_DATA_BOT,
+	       MAX (initial_k_data_limit, header->k_data_top - K_DATA_BOT));
+  initialize_registers ();
+  initialize_inst_tables ();
+  initialize_symbol_table ();
+
+  for (i = 0; i < header->symbol_count; i++)
+    {
+      label *l = lookup_label (strings + symbols[i].name);
+
+      l->addr = symbols[i].addr;
+      l->global_flag = (symbols[i].flags & IMAGE_GLOBAL) != 0;
+      l->gp_flag = (symbols[i].flags & IMAGE_GP) != 0;
+      l->const_flag = (symbols[i].flags & IMAGE_CONST) != 0;
+    }
+
+  restore_text (text_seg, text, header->text_count, strings);
+  restore_text (k_text_seg, k_text, header->k_text_count, strings);
+  memcpy (data_seg_b, data, header->data_size);
+  memcpy (k_data_seg_b, k_data, header->k_data_size);
+
+  k_text_begins_at_point (header->next_k_text_pc);
+  text_begins_at_point (header->next_text_pc);
+  k_data_begins_at_point (header->next_k_data_pc);
+  data_begins_at_point (DATA_BOT);
+  set_data_pc (header->next_data_pc);
+  gp_midpoint = header->gp_midpoint;
+
+  memcpy (R, header->R, sizeof (header->R));
+  HI = header->HI;
+  LO = header->LO;
+  PC = header->PC;
+  nPC = header->nPC;
+  memcpy (FPR, header->FPR, sizeof (header->FPR));
+  memcpy (CCR, header->CCR, sizeof (header->CCR));
+  memcpy (CPR, header->CPR, sizeof (header->CPR));
+
+#ifdef _WIN32
+  free (base);
+#else
+  munmap (base, st.st_size);
+#endif
+  return (true);
+}
+
+
+/* Rebuild the first COUNT instructions in the text segment SEG from
+   INSTS. */
+
+static void
+restore_text (instruction **seg, image_inst *insts, int count, char *strings)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    {
+      image_inst *ii = &insts[i];
+      instruction *inst;
+
+      if (ii->opcode == 0)
+	continue;
+
+      inst = (instruction *) zmalloc (sizeof (instruction));
+      SET_OPCODE (inst, ii->opcode);
+      inst->r_t = ii->r_t;
+      SET_ENCODING (inst, ii->encoding);
+      if (ii->source >= 0)
+	SET_SOURCE (inst, str_copy (strings + ii->source));
+      if (ii->flags & IMAGE_EXPR)
+	{
+	  imm_expr *expr = (imm_expr *) xmalloc (sizeof (imm_expr));
+
+	  expr->offset = ii->expr_offset;
+	  expr->bits = ii->expr_bits;
+	  expr->pc_relative = (ii->flags & IMAGE_PC_RELATIVE) != 0;
+	  if (ii->expr_symbol < 0)
+	    expr->symbol = NULL;
+	  else if (ii->flags & IMAGE_IN_TABLE)
+	    expr->symbol = lookup_label (strings + ii->expr_symbol);
+	  else
+	    {
+	      /* A local label from a file, which is no longer in the table. */
+	      label *l = (label *) zmalloc (sizeof (label));
+
+	      l->name = str_copy (strings + ii->expr_symbol);
+	      l->addr = ii->expr_symbol_addr;
+	      expr->symbol = l;
+	    }
+	  SET_EXPR (inst, expr);
+	}
+      seg[i] = inst;
+    }
+}
@@ -58,40 +58,56 @@ typedef struct addrexpr
    overlapping manner similar to the real encoding (but not identical, to
    speed decoding in C code, as opposed to hardware).. */
 
-typedef struct inst_s
+typedef union inst_fields_s
 {
-  short opcode;
-
-  union
+  /* R-type or I-type: */
+  struct
     {
-      /* R-type or I-type: */
-      struct
+      unsigned char rs;
+      unsigned char rt;
+
+      union
 	{
-	  unsigned char rs;
-	  unsigned char rt;
+	  short imm;
 
-	  union
+	  struct
 	    {
-	      short imm;
-
-	      struct
-		{
-		  unsigned char rd;
-		  unsigned char shamt;
-		} r;
-	    } r_i;
+	      unsigned char rd;
+	      unsigned char shamt;
+	    } r;
 	} r_i;
+    } r_i;
 
-      /* J-type: */
-      mem_addr target;
-    } r_t;
+  /* J-type: */
+  mem_addr target;
+} inst_fields;
 
+
+typedef struct inst_s
+{
+  short opcode;
+  inst_fields r_t;
   int32 encoding;
   imm_expr *expr;
   char *source_line;
 } instruction;
 
 
+/* The part of an instruction needed to execute it, packed into 8 bytes.
+   The simulator keeps an array of these in parallel with each text
+   segment. The field macros below work on either structure. */
+
+typedef struct packed_inst_s
+{
+  short opcode;
+  unsigned short flags;
+  inst_fields r_t;
+} packed_inst;
+
+#define PACKED_NOT_INST		0x1 /* No instruction at this address */
+#define PACKED_UNDEFINED	0x2 /* References an undefined symbol */
+
+
 #define OPCODE(INST)		(INST)->opcode
 #define SET_OPCODE(INST, VAL)	(INST)->opcode = (short)(VAL)
 
@@ -0,0 +1,1093 @@
+/* SPIM S20 MIPS simulator.
+   Compile MIPS basic blocks to x86-64 code.
+
+   Copyright (c) 1990-2010, James R. Larus.
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without modification,
+   are permitted provided that the following conditions are met:
+
+   Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+
+   Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation and/or
+   other materials provided with the distribution.
+
+   Neither the name of the James R. Larus nor the names of its contributors may be
+   used to endorse or promote products derived from this software without specific
+   prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+   AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+   IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+   ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+   LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+   CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+   GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+   HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+   OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "spim.h"
+#include "string-stream.h"
+#include "spim-utils.h"
+#include "inst.h"
+#include "reg.h"
+#include "mem.h"
+#include "sym-tbl.h"
+#include "parser_yacc.h"
+#include "jit.h"
+
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+
+/* A basic block is compiled into x86-64 code once the interpreter has
+   entered it JIT_HOT_THRESHOLD times.  Only integer instructions that
+   cannot change the processor state outside of the general registers,
+   HI, and LO are compiled, along with loads and stores, which use the
+   page table and call the usual memory functions for unmapped pages.  A
+   block ends at a branch or jump, or before an instruction that is not
+   compiled, such as a syscall.
+
+   The compiled code runs with the address of the register file in
+   %rbx and the number of instructions it may execute in %r12d.  Each
+   block checks that it can run to completion before it starts, so
+   execution stops after exactly the number of instructions that the
+   interpreter was asked for.  A block that ends with a branch or a jump
+   to another compiled block jumps straight to it.  Otherwise, and after
+   a load or store raises an exception or writes the text segment, the
+   compiled code returns the address of the next instruction to
+   execute, so the interpreter can take over. */
+
+#define JIT_HOT_THRESHOLD 16	/* Entries before a block is compiled */
+#define JIT_NEVER 0xffff	/* Block cannot be compiled */
+#define JIT_MAX_BLOCK 64	/* Instructions in a block */
+#define JIT_MAX_INST_BYTES 256	/* Code for one instruction and its exits */
+#define JIT_CODE_SIZE (4 * K * K)
+
+
+/* Compiled code is entered through a function that returns the address
+   of the next instruction in its low 32 bits and the number of
+   instructions it did not use in the high 32 bits. */
+
+typedef uint64_t (*jit_enter_fn) (reg_word *regs, int steps,
+				  unsigned char *block);
+
+
+/* An exit from a block to a block that has not been compiled yet.  The
+   jump at SITE is patched when the block at TARGET is compiled. */
+
+typedef struct
+{
+  unsigned char *site;		/* rel32 field of jump */
+  mem_addr target;
+} jit_link;
+
+
+/* An exit from a block to the interpreter. */
+
+typedef struct
+{
+  unsigned char *site;		/* rel32 field of jump */
+  mem_addr pc;			/* Next instruction to execute */
+  int unused;			/* Instructions of block not executed */
+  bool link;			/* => record a jit_link for this exit */
+} jit_exit;
+
+
+/* Local functions: */
+
+static unsigned char **block_entry (mem_addr pc, unsigned short **heat);
+static unsigned char *compile_block (mem_addr pc);
+static void emit_block_exit (int cc, mem_addr target);
+static bool emit_instruction (instruction *inst, mem_addr addr, int k,
+			      int length);
+static bool jit_compilable (instruction *inst, mem_addr addr);
+static bool jit_ends_block (instruction *inst);
+static bool jit_initialize ();
+static unsigned char *jit_indirect (mem_addr pc);
+
+
+/* Local variables: */
+
+static unsigned char *code_buf = NULL;
+static unsigned char *code_ptr;	/* Next free byte */
+static unsigned char *code_start; /* First byte after shared code */
+static jit_enter_fn jit_enter;
+static unsigned char *jit_epilogue;
+
+/* Compiled block and number of entries from the interpreter for each
+   word of the user and kernel text segments. */
+static unsigned char **text_blocks = NULL;
+static unsigned short *text_heat = NULL;
+static int text_words = 0;
+static unsigned char **k_text_blocks = NULL;
+static unsigned short *k_text_heat = NULL;
+static int k_text_words = 0;
+
+static jit_link *links = NULL;
+static int n_links = 0, max_links = 0;
+
+static jit_exit exits [2 * JIT_MAX_BLOCK + 2];
+static int n_exits;
+
+/* Offsets of other machine state from the register file. */
+static int32 pc_disp, hi_disp, lo_disp, exception_disp, text_modified_disp;
+static int32 data_modified_disp;
+
+
+/* x86-64 registers and condition codes used in compiled code. */
+
+#define X_EAX 0
+#define X_ECX 1
+#define X_EDX 2
+#define X_ESI 6
+#define X_EDI 7
+
+#define CC_O 0x0
+#define CC_B 0x2
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xc
+#define CC_GE 0xd
+#define CC_LE 0xe
+#define CC_G 0xf
+#define CC_ALWAYS -1
+
+#define REG_DISP(R) (4 * (R))
+
+
+static inline void
+emit_byte (int b)
+{
+  *code_ptr++ = (unsigned char) b;
+}
+
+
+static inline void
+emit_int32 (int32 v)
+{
+  memcpy (code_ptr, &v, sizeof (v));
+  code_ptr += sizeof (v);
+}
+
+
+static inline void
+emit_int64 (uint64_t v)
+{
+  memcpy (code_ptr, &v, sizeof (v));
+  code_ptr += sizeof (v);
+}
+
+
+/* Emit OPCODE with a ModRM operand of DISP(%rbx). REG is the register
+   or opcode extension field. */
+
+static void
+emit_rbx_op (int opcode, int reg, int32 disp)
+{
+  emit_byte (opcode);
+  emit_byte (0x80 | (reg << 3) | 3);
+  emit_int32 (disp);
+}
+
+
+/* Make the rel32 field at SITE jump to TARGET. */
+
+static void
+patch_rel32 (unsigned char *site, unsigned char *target)
+{
+  int32 rel = (int32) (target - (site + 4));
+
+  memcpy (site, &rel, sizeof (rel));
+}
+
+
+/* Emit a jump (if CC is CC_ALWAYS) or conditional jump, and return the
+   address of its rel32 field. */
+
+static unsigned char *
+emit_jump (int cc)
+{
+  unsigned char *site;
+
+  if (cc == CC_ALWAYS)
+    emit_byte (0xe9);
+  else
+    {
+      emit_byte (0x0f);
+      emit_byte (0x80 + cc);
+    }
+  site = code_ptr;
+  emit_int32 (0);
+  return site;
+}
+
+
+/* Emit a call to the C function at FN. */
+
+static void
+emit_call (uint64_t fn)
+{
+  emit_byte (0x48);		/* mov $fn, %rax */
+  emit_byte (0xb8);
+  emit_int64 (fn);
+  emit_byte (0xff);		/* call *%rax */
+  emit_byte (0xd0);
+}
+
+
+/* Emit a jump (if CC is CC_ALWAYS) or conditional jump to the
+   interpreter at PC, refunding the UNUSED instructions of the block. */
+
+static void
+emit_exit (int cc, mem_addr pc, int unused)
+{
+  exits [n_exits].site = emit_jump (cc);
+  exits [n_exits].pc = pc;
+  exits [n_exits].unused = unused;
+  exits [n_exits].link = false;
+  n_exits += 1;
+}
+
+
+/* Emit a jump (if CC is CC_ALWAYS) or conditional jump that leaves the
+   block for TARGET, at the end of the block. */
+
+static void
+emit_block_exit (int cc, mem_addr target)
+{
+  unsigned short *heat;
+  unsigned char **entry = block_entry (target, &heat);
+
+  if (entry != NULL && *entry != NULL)
+    patch_rel32 (emit_jump (cc), *entry);
+  else
+    {
+      emit_exit (cc, target, 0);
+      exits [n_exits - 1].link = (entry != NULL);
+    }
+}
+
+
+/* Return the location that holds the compiled block for the instruction
+   at PC and set *HEAT to its entry count, or return NULL if PC is not
+   in a text segment. */
+
+static unsigned char **
+block_entry (mem_addr pc, unsigned short **heat)
+{
+  int i;
+
+  if ((pc & 0x3) != 0)
+    return NULL;
+  else if ((pc >= TEXT_BOT) && (pc < text_top))
+    {
+      i = (pc - TEXT_BOT) >> 2;
+      if (i >= text_words)
+	return NULL;
+      *heat = &text_heat [i];
+      return &text_blocks [i];
+    }
+  else if ((pc >= K_TEXT_BOT) && (pc < k_text_top))
+    {
+      i = (pc - K_TEXT_BOT) >> 2;
+      if (i >= k_text_words)
+	return NULL;
+      *heat = &k_text_heat [i];
+      return &k_text_blocks [i];
+    }
+  else
+    return NULL;
+}
+
+
+/* Return the compiled block for PC, or NULL.  Called from compiled code
+   for jumps through a register. */
+
+static unsigned char *
+jit_indirect (mem_addr pc)
+{
+  unsigned short *heat;
+  unsigned char **entry = block_entry (pc, &heat);
+
+  return entry == NULL ? NULL : *entry;
+}
+
+
+/* Return the target of branch or jump INST at ADDR. */
+
+static mem_addr
+branch_target (instruction *inst, mem_addr addr)
+{
+  if (OPCODE (inst) == Y_J_OP || OPCODE (inst) == Y_JAL_OP)
+    return (addr & 0xf0000000) | TARGET (inst) << 2;
+  else
+    return addr + IDISP (inst);
+}
+
+
+/* Return true if INST at ADDR can be compiled. */
+
+static bool
+jit_compilable (instruction *inst, mem_addr addr)
+{
+  unsigned short *heat;
+
+  if (inst == NULL
+      || (EXPR (inst) != NULL
+	  && EXPR (inst)->symbol != NULL
+	  && EXPR (inst)->symbol->addr == 0))
+    return false;		/* Interpreter reports the error */
+
+  switch (OPCODE (inst))
+    {
+    case Y_ADDIU_OP: case Y_ADDU_OP: case Y_AND_OP: case Y_ANDI_OP:
+    case Y_DIV_OP: case Y_DIVU_OP: case Y_JR_OP: case Y_LUI_OP:
+    case Y_MFHI_OP: case Y_MFLO_OP: case Y_MTHI_OP: case Y_MTLO_OP:
+    case Y_MULT_OP: case Y_MULTU_OP: case Y_NOR_OP: case Y_OR_OP:
+    case Y_ORI_OP: case Y_SB_OP: case Y_SH_OP: case Y_SLL_OP:
+    case Y_SLLV_OP: case Y_SLT_OP: case Y_SLTI_OP: case Y_SLTIU_OP:
+    case Y_SLTU_OP: case Y_SRA_OP: case Y_SRAV_OP: case Y_SRL_OP:
+    case Y_SRLV_OP: case Y_SUBU_OP: case Y_SW_OP: case Y_XOR_OP:
+    case Y_XORI_OP:
+      return true;
+
+    case Y_ADD_OP: case Y_JALR_OP: case Y_MUL_OP: case Y_SUB_OP:
+      return RD (inst) != 0;
+
+    case Y_ADDI_OP: case Y_LB_OP: case Y_LBU_OP: case Y_LH_OP:
+    case Y_LHU_OP: case Y_LW_OP:
+      return RT (inst) != 0;
+
+    case Y_BEQ_OP: case Y_BGEZ_OP: case Y_BGEZAL_OP: case Y_BGTZ_OP:
+    case Y_BLEZ_OP: case Y_BLTZ_OP: case Y_BLTZAL_OP: case Y_BNE_OP:
+    case Y_J_OP: case Y_JAL_OP:
+      return block_entry (branch_target (inst, addr), &heat) != NULL;
+
+    default:
+      return false;
+    }
+}
+
+
+/* Return true if INST is a branch or jump, which ends a block. */
+
+static bool
+jit_ends_block (instruction *inst)
+{
+  switch (OPCODE (inst))
+    {
+    case Y_BEQ_OP: case Y_BGEZ_OP: case Y_BGEZAL_OP: case Y_BGTZ_OP:
+    case Y_BLEZ_OP: case Y_BLTZ_OP: case Y_BLTZAL_OP: case Y_BNE_OP:
+    case Y_J_OP: case Y_JAL_OP: case Y_JALR_OP: case Y_JR_OP:
+      return true;
+
+    default:
+      return false;
+    }
+}
+
+
+/* Emit code that computes the address R[RS] + SIMM of a load or store
+   in %edi and looks up its page.  If the page is mapped and the address
+   is aligned by MASK, the code continues with the page in %rcx and the
+   offset in %rax.  Otherwise it jumps to the rel32 fields that are
+   stored in SLOW. */
+
+static void
+emit_page_lookup (int rs, int32 simm, int mask, unsigned char **slow)
+{
+  emit_rbx_op (0x8b, X_EDI, REG_DISP (rs));
+  emit_byte (0x81);		/* add $simm, %edi */
+  emit_byte (0xc7);
+  emit_int32 (simm);
+  emit_byte (0x89);		/* mov %edi, %eax */
+  emit_byte (0xf8);
+  emit_byte (0xc1);		/* shr $PAGE_SHIFT, %eax */
+  emit_byte (0xe8);
+  emit_byte (PAGE_SHIFT);
+  emit_byte (0x48);		/* mov $data_pages, %rcx */
+  emit_byte (0xb9);
+  emit_int64 ((uintptr_t) data_pages);
+  emit_byte (0x48);		/* mov (%rcx,%rax,8), %rcx */
+  emit_byte (0x8b);
+  emit_byte (0x0c);
+  emit_byte (0xc1);
+  emit_byte (0x48);		/* test %rcx, %rcx */
+  emit_byte (0x85);
+  emit_byte (0xc9);
+  slow [0] = emit_jump (CC_E);
+  slow [1] = NULL;
+  if (mask != 0)
+    {
+      emit_byte (0xf7);		/* test $mask, %edi */
+      emit_byte (0xc7);
+      emit_int32 (mask);
+      slow [1] = emit_jump (CC_NE);
+    }
+  emit_byte (0x89);		/* mov %edi, %eax */
+  emit_byte (0xf8);
+  emit_byte (0x25);		/* and $PAGE_SIZE - 1, %eax */
+  emit_int32 (PAGE_SIZE - 1);
+}
+
+
+/* Make the jumps in SLOW, from emit_page_lookup, go to the current
+   location. */
+
+static void
+patch_slow_path (unsigned char **slow)
+{
+  patch_rel32 (slow [0], code_ptr);
+  if (slow [1] != NULL)
+    patch_rel32 (slow [1], code_ptr);
+}
+
+
+/* Emit code that leaves the block if the memory access by the K-th
+   instruction of a block of LENGTH raised an exception or (if STORE)
+   wrote the text segment. */
+
+static void
+emit_access_check (mem_addr addr, int k, int length, bool store)
+{
+  emit_rbx_op (0x83, 7, exception_disp); /* cmpl $0, exception_occurred */
+  emit_byte (0);
+  emit_exit (CC_NE, addr + BYTES_PER_WORD, length - k - 1);
+  if (store)
+    {
+      emit_rbx_op (0x80, 7, text_modified_disp); /* cmpb $0, text_modified */
+      emit_byte (0);
+      emit_exit (CC_NE, addr + BYTES_PER_WORD, length - k - 1);
+    }
+}
+
+
+/* Emit code for the K-th instruction, INST at ADDR, of a block of LENGTH
+   instructions. Return true if INST ends the block. */
+
+static bool
+emit_instruction (instruction *inst, mem_addr addr, int k, int length)
+{
+  int rs = RS (inst), rt = RT (inst), rd = RD (inst);
+  int32 simm = (short) IMM (inst), uimm = 0xffff & IMM (inst);
+  int shamt = SHAMT (inst) < 32 ? SHAMT (inst) : 0;
+  unsigned char *slow [2], *done;
+  int op;
+
+  switch (OPCODE (inst))
+    {
+      /* Register-register ALU operations: %eax = R[rs] op R[rt] */
+    case Y_ADD_OP: op = 0x03; goto alu_rr;
+    case Y_ADDU_OP: op = 0x03; goto alu_rr;
+    case Y_AND_OP: op = 0x23; goto alu_rr;
+    case Y_NOR_OP: op = 0x0b; goto alu_rr;
+    case Y_OR_OP: op = 0x0b; goto alu_rr;
+    case Y_SUB_OP: op = 0x2b; goto alu_rr;
+    case Y_SUBU_OP: op = 0x2b; goto alu_rr;
+    case Y_XOR_OP: op = 0x33; goto alu_rr;
+    alu_rr:
+      if (rd == 0)
+	break;			/* No effect */
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_rbx_op (op, X_EAX, REG_DISP (rt));
+      if (OPCODE (inst) == Y_ADD_OP || OPCODE (inst) == Y_SUB_OP)
+	/* Overflow: let the interpreter raise the exception */
+	emit_exit (CC_O, addr, length - k);
+      if (OPCODE (inst) == Y_NOR_OP)
+	{
+	  emit_byte (0xf7);	/* not %eax */
+	  emit_byte (0xd0);
+	}
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rd));
+      break;
+
+      /* Register-immediate ALU operations: %eax = R[rs] op imm */
+    case Y_ADDI_OP: op = 0x05; goto alu_ri;
+    case Y_ADDIU_OP: op = 0x05; goto alu_ri;
+    case Y_ANDI_OP: op = 0x25; simm = uimm; goto alu_ri;
+    case Y_ORI_OP: op = 0x0d; simm = uimm; goto alu_ri;
+    case Y_XORI_OP: op = 0x35; simm = uimm; goto alu_ri;
+    alu_ri:
+      if (rt == 0)
+	break;
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_byte (op);
+      emit_int32 (simm);
+      if (OPCODE (inst) == Y_ADDI_OP)
+	emit_exit (CC_O, addr, length - k);
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rt));
+      break;
+
+    case Y_LUI_OP:
+      if (rt != 0)
+	{
+	  emit_rbx_op (0xc7, 0, REG_DISP (rt));
+	  emit_int32 ((IMM (inst) << 16) & 0xffff0000);
+	}
+      break;
+
+      /* Comparisons: R[d] = (%eax cmp operand) */
+    case Y_SLT_OP: op = 0x9c; goto cmp_rr;
+    case Y_SLTU_OP: op = 0x92; goto cmp_rr;
+    cmp_rr:
+      if (rd == 0)
+	break;
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_rbx_op (0x3b, X_EAX, REG_DISP (rt));
+      rt = rd;
+      goto set_cc;
+
+    case Y_SLTI_OP: op = 0x9c; goto cmp_ri;
+    case Y_SLTIU_OP: op = 0x92; goto cmp_ri;
+    cmp_ri:
+      if (rt == 0)
+	break;
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_byte (0x3d);		/* cmp $simm, %eax */
+      emit_int32 (simm);
+    set_cc:
+      emit_byte (0x0f);		/* setcc %al */
+      emit_byte (op);
+      emit_byte (0xc0);
+      emit_byte (0x0f);		/* movzbl %al, %eax */
+      emit_byte (0xb6);
+      emit_byte (0xc0);
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rt));
+      break;
+
+      /* Shifts */
+    case Y_SLL_OP: op = 0xe0; goto shift_imm;
+    case Y_SRA_OP: op = 0xf8; goto shift_imm;
+    case Y_SRL_OP: op = 0xe8; goto shift_imm;
+    shift_imm:
+      if (rd == 0)
+	break;
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rt));
+      emit_byte (0xc1);
+      emit_byte (op);
+      emit_byte (shamt);
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rd));
+      break;
+
+    case Y_SLLV_OP: op = 0xe0; goto shift_var;
+    case Y_SRAV_OP: op = 0xf8; goto shift_var;
+    case Y_SRLV_OP: op = 0xe8; goto shift_var;
+    shift_var:
+      if (rd == 0)
+	break;
+      /* x86 also uses the low 5 bits of %cl */
+      emit_rbx_op (0x8b, X_ECX, REG_DISP (rs));
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rt));
+      emit_byte (0xd3);
+      emit_byte (op);
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rd));
+      break;
+
+      /* HI and LO */
+    case Y_MUL_OP: op = 5; goto multiply;
+    case Y_MULT_OP: op = 5; goto multiply;
+    case Y_MULTU_OP: op = 4; goto multiply;
+    multiply:
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_rbx_op (0xf7, op, REG_DISP (rt)); /* (i)mull R[rt] */
+      emit_rbx_op (0x89, X_EAX, lo_disp);
+      emit_rbx_op (0x89, X_EDX, hi_disp);
+      if (OPCODE (inst) == Y_MUL_OP)
+	emit_rbx_op (0x89, X_EAX, REG_DISP (rd));
+      break;
+
+    case Y_DIV_OP:
+    case Y_DIVU_OP:
+      {
+	unsigned char *zero, *big, *small;
+
+	/* The result is undefined (and R[rs] / R[rt] is not computed) on
+	   divide by zero or overflow. */
+	emit_rbx_op (0x8b, X_ECX, REG_DISP (rt));
+	emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+	emit_byte (0x85);	/* test %ecx, %ecx */
+	emit_byte (0xc9);
+	zero = emit_jump (CC_E);
+	emit_byte (0x3d);	/* cmp $0x80000000, %eax */
+	emit_int32 ((int32) 0x80000000);
+	small = emit_jump (CC_NE);
+	emit_byte (0x83);	/* cmp $-1, %ecx */
+	emit_byte (0xf9);
+	emit_byte (0xff);
+	big = emit_jump (CC_E);
+	patch_rel32 (small, code_ptr);
+	if (OPCODE (inst) == Y_DIV_OP)
+	  {
+	    emit_byte (0x99);	/* cltd */
+	    emit_byte (0xf7);	/* idivl %ecx */
+	    emit_byte (0xf9);
+	  }
+	else
+	  {
+	    emit_byte (0x31);	/* xor %edx, %edx */
+	    emit_byte (0xd2);
+	    emit_byte (0xf7);	/* divl %ecx */
+	    emit_byte (0xf1);
+	  }
+	emit_rbx_op (0x89, X_EAX, lo_disp);
+	emit_rbx_op (0x89, X_EDX, hi_disp);
+	patch_rel32 (zero, code_ptr);
+	patch_rel32 (big, code_ptr);
+	break;
+      }
+
+    case Y_MFHI_OP:
+    case Y_MFLO_OP:
+      if (rd != 0)
+	{
+	  emit_rbx_op (0x8b, X_EAX,
+		       OPCODE (inst) == Y_MFHI_OP ? hi_disp : lo_disp);
+	  emit_rbx_op (0x89, X_EAX, REG_DISP (rd));
+	}
+      break;
+
+    case Y_MTHI_OP:
+    case Y_MTLO_OP:
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_rbx_op (0x89, X_EAX,
+		   OPCODE (inst) == Y_MTHI_OP ? hi_disp : lo_disp);
+      break;
+
+      /* Loads and stores access mapped pages directly.  Otherwise, they
+	 call the memory functions, with PC set in case they raise an
+	 exception. */
+    case Y_LB_OP: op = 0xbe; goto load;
+    case Y_LBU_OP: op = 0xb6; goto load;
+    case Y_LH_OP: op = 0xbf; goto load;
+    case Y_LHU_OP: op = 0xb7; goto load;
+    case Y_LW_OP: op = 0x8b; goto load;
+    load:
+      emit_page_lookup (rs, simm, (OPCODE (inst) == Y_LW_OP ? 0x3
+				   : op == 0xbf || op == 0xb7 ? 0x1 : 0x0),
+			slow);
+      if (op != 0x8b)
+	emit_byte (0x0f);	/* movs/movz (%rcx,%rax), %eax */
+      emit_byte (op);		/* or mov (%rcx,%rax), %eax */
+      emit_byte (0x04);
+      emit_byte (0x01);
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rt));
+      done = emit_jump (CC_ALWAYS);
+
+      patch_slow_path (slow);
+      emit_rbx_op (0xc7, 0, pc_disp);
+      emit_int32 (addr);
+      emit_rbx_op (0x8b, X_EDI, REG_DISP (rs));
+      emit_byte (0x81);		/* add $simm, %edi */
+      emit_byte (0xc7);
+      emit_int32 (simm);
+      if (OPCODE (inst) == Y_LW_OP)
+	emit_call ((uintptr_t) read_mem_word);
+      else if (OPCODE (inst) == Y_LH_OP || OPCODE (inst) == Y_LHU_OP)
+	emit_call ((uintptr_t) read_mem_half);
+      else
+	emit_call ((uintptr_t) read_mem_byte);
+      if (OPCODE (inst) == Y_LBU_OP || OPCODE (inst) == Y_LHU_OP)
+	{
+	  emit_byte (0x25);	/* and $mask, %eax */
+	  emit_int32 (OPCODE (inst) == Y_LBU_OP ? 0xff : 0xffff);
+	}
+      emit_rbx_op (0x89, X_EAX, REG_DISP (rt));
+      emit_access_check (addr, k, length, false);
+      patch_rel32 (done, code_ptr);
+      break;
+
+    case Y_SB_OP:
+    case Y_SH_OP:
+    case Y_SW_OP:
+      emit_page_lookup (rs, simm, (OPCODE (inst) == Y_SW_OP ? 0x3
+				   : OPCODE (inst) == Y_SH_OP ? 0x1 : 0x0),
+			slow);
+      emit_rbx_op (0x8b, X_ESI, REG_DISP (rt));
+      if (OPCODE (inst) == Y_SH_OP)
+	emit_byte (0x66);	/* mov %si, (%rcx,%rax) */
+      else if (OPCODE (inst) == Y_SB_OP)
+	emit_byte (0x40);	/* mov %sil, (%rcx,%rax) */
+      emit_byte (OPCODE (inst) == Y_SB_OP ? 0x88 : 0x89);
+      emit_byte (0x34);
+      emit_byte (0x01);
+      emit_rbx_op (0xc6, 0, data_modified_disp); /* movb $1, data_modified */
+      emit_byte (1);
+      done = emit_jump (CC_ALWAYS);
+
+      patch_slow_path (slow);
+      emit_rbx_op (0xc7, 0, pc_disp);
+      emit_int32 (addr);
+      emit_rbx_op (0x8b, X_EDI, REG_DISP (rs));
+      emit_byte (0x81);		/* add $simm, %edi */
+      emit_byte (0xc7);
+      emit_int32 (simm);
+      emit_rbx_op (0x8b, X_ESI, REG_DISP (rt));
+      if (OPCODE (inst) == Y_SW_OP)
+	emit_call ((uintptr_t) set_mem_word);
+      else if (OPCODE (inst) == Y_SH_OP)
+	emit_call ((uintptr_t) set_mem_half);
+      else
+	emit_call ((uintptr_t) set_mem_byte);
+      emit_access_check (addr, k, length, true);
+      patch_rel32 (done, code_ptr);
+      break;
+
+      /* Branches and jumps end the block. */
+    case Y_BEQ_OP: op = CC_E; goto branch_rr;
+    case Y_BNE_OP: op = CC_NE; goto branch_rr;
+    branch_rr:
+      emit_rbx_op (0x8b, X_EAX, REG_DISP (rs));
+      emit_rbx_op (0x3b, X_EAX, REG_DISP (rt));
+      emit_block_exit (op, branch_target (inst, addr));
+      emit_block_exit (CC_ALWAYS, addr + BYTES_PER_WORD);
+      return true;
+
+    case Y_BGEZAL_OP: op = CC_GE; goto branch_link;
+    case Y_BLTZAL_OP: op = CC_L; goto branch_link;
+    branch_link:
+      emit_rbx_op (0xc7, 0, REG_DISP (31));
+      emit_int32 (addr + BYTES_PER_WORD);
+      goto branch_z;
+    case Y_BGEZ_OP: op = CC_GE; goto branch_z;
+    case Y_BGTZ_OP: op = CC_G; goto branch_z;
+    case Y_BLEZ_OP: op = CC_LE; goto branch_z;
+    case Y_BLTZ_OP: op = CC_L; goto branch_z;
+    branch_z:
+      emit_rbx_op (0x83, 7, REG_DISP (rs)); /* cmpl $0, R[rs] */
+      emit_byte (0);
+      emit_block_exit (op, branch_target (inst, addr));
+      emit_block_exit (CC_ALWAYS, addr + BYTES_PER_WORD);
+      return true;
+
+    case Y_JAL_OP:
+      emit_rbx_op (0xc7, 0, REG_DISP (31));
+      emit_int32 (addr + BYTES_PER_WORD);
+      /* Fall through */
+    case Y_J_OP:
+      emit_block_exit (CC_ALWAYS, branch_target (inst, addr));
+      return true;
+
+    case Y_JALR_OP:
+    case Y_JR_OP:
+      {
+	unsigned char *miss;
+
+	emit_byte (0x44);	/* mov R[rs], %r13d */
+	emit_rbx_op (0x8b, 5, REG_DISP (rs));
+	if (OPCODE (inst) == Y_JALR_OP)
+	  {
+	    emit_rbx_op (0xc7, 0, REG_DISP (rd));
+	    emit_int32 (addr + BYTES_PER_WORD);
+	  }
+	emit_byte (0x44);	/* mov %r13d, %edi */
+	emit_byte (0x89);
+	emit_byte (0xef);
+	emit_call ((uintptr_t) jit_indirect);
+	emit_byte (0x48);	/* test %rax, %rax */
+	emit_byte (0x85);
+	emit_byte (0xc0);
+	miss = emit_jump (CC_E);
+	emit_byte (0xff);	/* jmp *%rax */
+	emit_byte (0xe0);
+	patch_rel32 (miss, code_ptr);
+	emit_byte (0x44);	/* mov %r13d, %eax */
+	emit_byte (0x89);
+	emit_byte (0xe8);
+	patch_rel32 (emit_jump (CC_ALWAYS), jit_epilogue);
+	return true;
+      }
+
+    default:
+      fatal_error ("JIT cannot compile instruction type: %d\n", OPCODE (inst));
+      break;
+    }
+  return false;
+}
+
+
+/* Compile the basic block starting at PC and return its code, or NULL
+   if its first instruction cannot be compiled. */
+
+static unsigned char *
+compile_block (mem_addr pc)
+{
+  unsigned short *heat;
+  unsigned char *entry, *bail;
+  int length, k, i;
+  bool ended = false;
+
+  for (length = 0; length < JIT_MAX_BLOCK; length += 1)
+    {
+      instruction *inst = read_mem_inst (pc + length * BYTES_PER_WORD);
+
+      if (!jit_compilable (inst, pc + length * BYTES_PER_WORD))
+	break;
+      if (jit_ends_block (inst))
+	{
+	  length += 1;
+	  break;
+	}
+    }
+  if (length == 0)
+    return NULL;
+
+  if (code_ptr + (length + 1) * JIT_MAX_INST_BYTES
+      > code_buf + JIT_CODE_SIZE)
+    jit_reset ();		/* Out of space: start over */
+
+  /* Check that the block can run to completion. */
+  entry = code_ptr;
+  n_exits = 0;
+  emit_byte (0x41);		/* cmp $length, %r12d */
+  emit_byte (0x81);
+  emit_byte (0xfc);
+  emit_int32 (length);
+  bail = emit_jump (CC_L);
+  emit_byte (0x41);		/* sub $length, %r12d */
+  emit_byte (0x81);
+  emit_byte (0xec);
+  emit_int32 (length);
+
+  for (k = 0; k < length && !ended; k += 1)
+    {
+      mem_addr addr = pc + k * BYTES_PER_WORD;
+
+      ended = emit_instruction (read_mem_inst (addr), addr, k, length);
+    }
+  if (!ended)
+    emit_block_exit (CC_ALWAYS, pc + length * BYTES_PER_WORD);
+
+  /* Exits to the interpreter */
+  patch_rel32 (bail, code_ptr);
+  emit_byte (0xb8);		/* mov $pc, %eax */
+  emit_int32 (pc);
+  patch_rel32 (emit_jump (CC_ALWAYS), jit_epilogue);
+  for (i = 0; i < n_exits; i += 1)
+    {
+      patch_rel32 (exits [i].site, code_ptr);
+      if (exits [i].link)
+	{
+	  if (n_links == max_links)
+	    {
+	      max_links = max_links == 0 ? 256 : 2 * max_links;
+	      links = (jit_link *) realloc (links, max_links * sizeof (jit_link));
+	    }
+	  links [n_links].site = exits [i].site;
+	  links [n_links].target = exits [i].pc;
+	  n_links += 1;
+	}
+      if (exits [i].unused != 0)
+	{
+	  emit_byte (0x41);	/* add $unused, %r12d */
+	  emit_byte (0x81);
+	  emit_byte (0xc4);
+	  emit_int32 (exits [i].unused);
+	}
+      emit_byte (0xb8);		/* mov $pc, %eax */
+      emit_int32 (exits [i].pc);
+      patch_rel32 (emit_jump (CC_ALWAYS), jit_epilogue);
+    }
+
+  /* Link blocks that exit to this one (including itself). */
+  *block_entry (pc, &heat) = entry;
+  for (i = 0; i < n_links; )
+    if (links [i].target == pc)
+      {
+	patch_rel32 (links [i].site, entry);
+	links [i] = links [n_links - 1];
+	n_links -= 1;
+      }
+  else
+      i += 1;
+
+  return entry;
+}
+
+
+/* Allocate the code buffer and emit the code that enters and leaves
+   compiled blocks. Return false if compiled code cannot be run. */
+
+static bool
+jit_initialize ()
+{
+  intptr_t disps [6];
+  int i;
+
+  disps [0] = (char *) &PC - (char *) R;
+  disps [1] = (char *) &HI - (char *) R;
+  disps [2] = (char *) &LO - (char *) R;
+  disps [3] = (char *) &exception_occurred - (char *) R;
+  disps [4] = (char *) &text_modified - (char *) R;
+  disps [5] = (char *) &data_modified - (char *) R;
+  for (i = 0; i < 6; i += 1)
+    if (disps [i] != (int32) disps [i])
+      return false;
+  pc_disp = (int32) disps [0];
+  hi_disp = (int32) disps [1];
+  lo_disp = (int32) disps [2];
+  exception_disp = (int32) disps [3];
+  text_modified_disp = (int32) disps [4];
+  data_modified_disp = (int32) disps [5];
+
+  code_buf = (unsigned char *) mmap (NULL, JIT_CODE_SIZE,
+				     PROT_READ | PROT_WRITE | PROT_EXEC,
+				     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (code_buf == (unsigned char *) MAP_FAILED)
+    {
+      code_buf = NULL;
+      return false;
+    }
+  code_ptr = code_buf;
+
+  /* jit_enter (regs, steps, block): save callee-saved registers, keeping
+     the stack 16-byte aligned for calls, and jump to block. */
+  jit_enter = (jit_enter_fn) (uintptr_t) code_ptr;
+  emit_byte (0x53);		/* push %rbx */
+  emit_byte (0x41);		/* push %r12 */
+  emit_byte (0x54);
+  emit_byte (0x41);		/* push %r13 */
+  emit_byte (0x55);
+  emit_byte (0x55);		/* push %rbp */
+  emit_byte (0x48);		/* sub $8, %rsp */
+  emit_byte (0x83);
+  emit_byte (0xec);
+  emit_byte (0x08);
+  emit_byte (0x48);		/* mov %rdi, %rbx */
+  emit_byte (0x89);
+  emit_byte (0xfb);
+  emit_byte (0x41);		/* mov %esi, %r12d */
+  emit_byte (0x89);
+  emit_byte (0xf4);
+  emit_byte (0xff);		/* jmp *%rdx */
+  emit_byte (0xe2);
+
+  /* Return the next PC (in %eax) and the unused steps. */
+  jit_epilogue = code_ptr;
+  emit_byte (0x44);		/* mov %r12d, %edx */
+  emit_byte (0x89);
+  emit_byte (0xe2);
+  emit_byte (0x48);		/* shl $32, %rdx */
+  emit_byte (0xc1);
+  emit_byte (0xe2);
+  emit_byte (0x20);
+  emit_byte (0x48);		/* or %rdx, %rax */
+  emit_byte (0x09);
+  emit_byte (0xd0);
+  emit_byte (0x48);		/* add $8, %rsp */
+  emit_byte (0x83);
+  emit_byte (0xc4);
+  emit_byte (0x08);
+  emit_byte (0x5d);		/* pop %rbp */
+  emit_byte (0x41);		/* pop %r13 */
+  emit_byte (0x5d);
+  emit_byte (0x41);		/* pop %r12 */
+  emit_byte (0x5c);
+  emit_byte (0x5b);		/* pop %rbx */
+  emit_byte (0xc3);		/* ret */
+
+  code_start = code_ptr;
+  return true;
+}
+
+
+/* Discard all compiled code, as the text segment has changed. Return
+   false if compiled code cannot be run on this machine. */
+
+bool
+jit_reset ()
+{
+  int words;
+
+  if (code_buf == NULL && !jit_initialize ())
+    return false;
+  code_ptr = code_start;
+  n_links = 0;
+
+  words = (text_top - TEXT_BOT) / BYTES_PER_WORD;
+  if (words != text_words)
+    {
+      free (text_blocks);
+      free (text_heat);
+      text_blocks = (unsigned char **) xmalloc (words * sizeof (unsigned char *));
+      text_heat = (unsigned short *) xmalloc (words * sizeof (unsigned short));
+      text_words = words;
+    }
+  memclr (text_blocks, words * sizeof (unsigned char *));
+  memclr (text_heat, words * sizeof (unsigned short));
+
+  words = (k_text_top - K_TEXT_BOT) / BYTES_PER_WORD;
+  if (words != k_text_words)
+    {
+      free (k_text_blocks);
+      free (k_text_heat);
+      k_text_blocks = (unsigned char **) xmalloc (words * sizeof (unsigned char *));
+      k_text_heat = (unsigned short *) xmalloc (words * sizeof (unsigned short));
+      k_text_words = words;
+    }
+  memclr (k_text_blocks, words * sizeof (unsigned char *));
+  memclr (k_text_heat, words * sizeof (unsigned short));
+  return true;
+}
+
+
+/* Execute at most STEPS instructions of compiled code starting at PC.
+   Return the number of instructions executed, and leave PC at the next
+   one, or return 0 if the block at PC has not been compiled. */
+
+int
+jit_execute (mem_addr pc, int steps)
+{
+  unsigned short *heat;
+  unsigned char **entry = block_entry (pc, &heat);
+  uint64_t result;
+
+  if (entry == NULL)
+    return 0;
+  if (*entry == NULL)
+    {
+      if (*heat == JIT_NEVER || ++*heat < JIT_HOT_THRESHOLD)
+	return 0;
+      if (compile_block (pc) == NULL)
+	{
+	  *heat = JIT_NEVER;
+	  return 0;
+	}
+      entry = block_entry (pc, &heat);	/* jit_reset may have run */
+    }
+
+  result = jit_enter (R, steps, *entry);
+  PC = (mem_addr) result;
+  return steps - (int) (result >> 32);
+}
+
+#else
+
+/* No compiler for this machine. */
+
+bool
+jit_reset ()
+{
+  return false;
+}
+
+
+int
+jit_execute (mem_addr pc, int steps)
+{
+  pc = pc;
+  steps = steps;
+  return 0;
+}
+
+#endif
@@ -48,6 +48,8 @@ double *FPR;			/* Dynamically allocate so overlay */
 float *FGR;			/* is possible */
 int *FWR;			/* is possible */
 reg_word CCR[4][32], CPR[4][32];
+int CP0_Count_cycles;
+int64 instructions_executed;
 
 instruction **text_seg;
 bool text_modified;		/* => text segment was written */
@@ -68,6 +70,8 @@ mem_word *k_data_seg;
 short *k_data_seg_h;
 BYTE_TYPE *k_data_seg_b;
 mem_addr k_data_top;
+BYTE_TYPE **data_pages;
+instruction ***text_pages;
 
 
 /* Local functions: */
@@ -77,6 +81,8 @@ static void bad_mem_write (mem_addr addr, mem_word value, int mask);
 static instruction *bad_text_read (mem_addr addr);
 static void bad_text_write (mem_addr addr, instruction *inst);
 static void free_instructions (instruction **inst, int n);
+static void map_data_pages (mem_addr bot, mem_addr top, BYTE_TYPE *seg);
+static void map_text_pages (mem_addr bot, mem_addr top, instruction **seg);
 static mem_word read_memory_mapped_IO (mem_addr addr);
 static void write_memory_mapped_IO (mem_addr addr, mem_word value);
 
@@ -181,6 +187,27 @@ make_memory (int text_size, int data_size, int data_limit,
   k_data_top = K_DATA_BOT + k_data_size;
   k_data_size_limit = k_data_limit;
 
+  if (data_pages == NULL)
+    {
+      /* Fresh storage from calloc is already clear, and the pages of the
+	 tables that are never touched need not be allocated at all. */
+      data_pages = (BYTE_TYPE **) calloc (PAGE_COUNT, sizeof (BYTE_TYPE *));
+      text_pages = (instruction ***) calloc (PAGE_COUNT,
+					     sizeof (instruction **));
+      if (data_pages == NULL || text_pages == NULL)
+	fatal_error ("Out of memory at request for page tables.\n");
+    }
+  else
+    {
+      memclr (data_pages, PAGE_COUNT * sizeof (BYTE_TYPE *));
+      memclr (text_pages, PAGE_COUNT * sizeof (instruction **));
+    }
+  map_text_pages (TEXT_BOT, text_top, text_seg);
+  map_data_pages (DATA_BOT, data_top, data_seg_b);
+  map_data_pages (stack_bot, STACK_TOP, stack_seg_b);
+  map_text_pages (K_TEXT_BOT, k_text_top, k_text_seg);
+  map_data_pages (K_DATA_BOT, k_data_top, k_data_seg_b);
+
   text_modified = true;
   data_modified = true;
 }
@@ -197,6 +224,33 @@ free_instructions (instruction **inst, int n)
 }
 
 
+/* Map the pages that lie entirely in the segment from BOT up to TOP
+   (exclusive) to the segment's storage at SEG. */
+
+static void
+map_data_pages (mem_addr bot, mem_addr top, BYTE_TYPE *seg)
+{
+  mem_addr page;
+
+  for (page = ROUND_UP (bot, PAGE_SIZE);
+       page >= bot && page < top && top - page >= PAGE_SIZE;
+       page += PAGE_SIZE)
+    data_pages [PAGE_NUMBER (page)] = seg + (page - bot);
+}
+
+
+static void
+map_text_pages (mem_addr bot, mem_addr top, instruction **seg)
+{
+  mem_addr page;
+
+  for (page = ROUND_UP (bot, PAGE_SIZE);
+       page >= bot && page < top && top - page >= PAGE_SIZE;
+       page += PAGE_SIZE)
+    text_pages [PAGE_NUMBER (page)] = seg + (page - bot) / BYTES_PER_WORD;
+}
+
+
 /* Expand the data segment by adding N bytes. */
 
 void
@@ -224,6 +278,8 @@ expand_data (int addl_bytes)
   /* Zero new memory */
   for (p = data_seg_b + old_size; p < data_seg_b + new_size; )
     *p ++ = 0;
+
+  map_data_pages (DATA_BOT, data_top, data_seg_b);
 }
 
 
@@ -258,6 +314,8 @@ expand_stack (int addl_bytes)
   stack_seg_b = (BYTE_TYPE *) stack_seg;
   stack_seg_h = (short *) stack_seg;
   stack_bot -= (new_size - old_size);
+
+  map_data_pages (stack_bot, STACK_TOP, stack_seg_b);
 }
 
 
@@ -288,6 +346,8 @@ expand_k_data (int addl_bytes)
   for (p = k_data_seg_b + old_size / BYTES_PER_WORD;
        p < k_data_seg_b + new_size / BYTES_PER_WORD; )
     *p ++ = 0;
+
+  map_data_pages (K_DATA_BOT, k_data_top, k_data_seg_b);
 }
 
 
@@ -297,7 +357,11 @@ expand_k_data (int addl_bytes)
 void*
 mem_reference(mem_addr addr)
 {
-  if ((addr >= TEXT_BOT) && (addr < text_top))
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
+  if (page != NULL)
+    return page + PAGE_OFFSET (addr);
+  else if ((addr >= TEXT_BOT) && (addr < text_top))
     return addr - TEXT_BOT + (char*) text_seg;
   else if ((addr >= DATA_BOT) && (addr < data_top))
     return addr - DATA_BOT + (char*) data_seg;
@@ -318,7 +382,11 @@ mem_reference(mem_addr addr)
 instruction*
 read_mem_inst(mem_addr addr)
 {
-  if ((addr >= TEXT_BOT) && (addr < text_top) && !(addr & 0x3))
+  instruction **page = text_pages [PAGE_NUMBER (addr)];
+
+  if (page != NULL && !(addr & 0x3))
+    return page [PAGE_OFFSET (addr) >> 2];
+  else if ((addr >= TEXT_BOT) && (addr < text_top) && !(addr & 0x3))
     return text_seg [(addr - TEXT_BOT) >> 2];
   else if ((addr >= K_TEXT_BOT) && (addr < k_text_top) && !(addr & 0x3))
     return k_text_seg [(addr - K_TEXT_BOT) >> 2];
@@ -330,7 +398,11 @@ read_mem_inst(mem_addr addr)
 reg_word
 read_mem_byte(mem_addr addr)
 {
-  if ((addr >= DATA_BOT) && (addr < data_top))
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
+  if (page != NULL)
+    return page [PAGE_OFFSET (addr)];
+  else if ((addr >= DATA_BOT) && (addr < data_top))
     return data_seg_b [addr - DATA_BOT];
   else if ((addr >= stack_bot) && (addr < STACK_TOP))
     return stack_seg_b [addr - stack_bot];
@@ -344,7 +416,11 @@ read_mem_byte(mem_addr addr)
 reg_word
 read_mem_half(mem_addr addr)
 {
-  if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x1))
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
+  if (page != NULL && !(addr & 0x1))
+    return *(short *) (page + PAGE_OFFSET (addr));
+  else if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x1))
     return data_seg_h [(addr - DATA_BOT) >> 1];
   else if ((addr >= stack_bot) && (addr < STACK_TOP) && !(addr & 0x1))
     return stack_seg_h [(addr - stack_bot) >> 1];
@@ -358,7 +434,11 @@ read_mem_half(mem_addr addr)
 reg_word
 read_mem_word(mem_addr addr)
 {
-  if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x3))
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
+  if (page != NULL && !(addr & 0x3))
+    return *(mem_word *) (page + PAGE_OFFSET (addr));
+  else if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x3))
     return data_seg [(addr - DATA_BOT) >> 2];
   else if ((addr >= stack_bot) && (addr < STACK_TOP) && !(addr & 0x3))
     return stack_seg [(addr - stack_bot) >> 2];
@@ -372,8 +452,12 @@ read_mem_word(mem_addr addr)
 void
 set_mem_inst(mem_addr addr, instruction* inst)
 {
+  instruction **page = text_pages [PAGE_NUMBER (addr)];
+
   text_modified = true;
-  if ((addr >= TEXT_BOT) && (addr < text_top) && !(addr & 0x3))
+  if (page != NULL && !(addr & 0x3))
+    page [PAGE_OFFSET (addr) >> 2] = inst;
+  else if ((addr >= TEXT_BOT) && (addr < text_top) && !(addr & 0x3))
     text_seg [(addr - TEXT_BOT) >> 2] = inst;
   else if ((addr >= K_TEXT_BOT) && (addr < k_text_top) && !(addr & 0x3))
     k_text_seg [(addr - K_TEXT_BOT) >> 2] = inst;
@@ -385,8 +469,12 @@ set_mem_inst(mem_addr addr, instruction* inst)
 void
 set_mem_byte(mem_addr addr, reg_word value)
 {
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
   data_modified = true;
-  if ((addr >= DATA_BOT) && (addr < data_top))
+  if (page != NULL)
+    page [PAGE_OFFSET (addr)] = (BYTE_TYPE) value;
+  else if ((addr >= DATA_BOT) && (addr < data_top))
     data_seg_b [addr - DATA_BOT] = (BYTE_TYPE) value;
   else if ((addr >= stack_bot) && (addr < STACK_TOP))
     stack_seg_b [addr - stack_bot] = (BYTE_TYPE) value;
@@ -400,8 +488,12 @@ set_mem_byte(mem_addr addr, reg_word value)
 void
 set_mem_half(mem_addr addr, reg_word value)
 {
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
   data_modified = true;
-  if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x1))
+  if (page != NULL && !(addr & 0x1))
+    *(short *) (page + PAGE_OFFSET (addr)) = (short) value;
+  else if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x1))
     data_seg_h [(addr - DATA_BOT) >> 1] = (short) value;
   else if ((addr >= stack_bot) && (addr < STACK_TOP) && !(addr & 0x1))
     stack_seg_h [(addr - stack_bot) >> 1] = (short) value;
@@ -415,8 +507,12 @@ set_mem_half(mem_addr addr, reg_word value)
 void
 set_mem_word(mem_addr addr, reg_word value)
 {
+  BYTE_TYPE *page = data_pages [PAGE_NUMBER (addr)];
+
   data_modified = true;
-  if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x3))
+  if (page != NULL && !(addr & 0x3))
+    *(mem_word *) (page + PAGE_OFFSET (addr)) = (mem_word) value;
+  else if ((addr >= DATA_BOT) && (addr < data_top) && !(addr & 0x3))
     data_seg [(addr - DATA_BOT) >> 2] = (mem_word) value;
   else if ((addr >= stack_bot) && (addr < STACK_TOP) && !(addr & 0x3))
     stack_seg [(addr - stack_bot) >> 2] = (mem_word) value;
@@ -113,6 +113,22 @@ extern BYTE_TYPE *k_data_seg_b;
 extern mem_addr k_data_top;
 
 
+/* Memory is also mapped by a page table, which holds the host address of
+   each page of a data or text segment, or NULL. Only pages that lie
+   entirely in a segment are mapped, so a reference to an unmapped page
+   is checked against the segment boundaries. */
+
+#define PAGE_SHIFT 12		/* 4 KB pages */
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define PAGE_NUMBER(ADDR) ((ADDR) >> PAGE_SHIFT)
+#define PAGE_OFFSET(ADDR) ((ADDR) & (PAGE_SIZE - 1))
+#define PAGE_COUNT (1 << (32 - PAGE_SHIFT))
+
+extern BYTE_TYPE **data_pages;	/* Data, stack, and kernel data */
+
+extern instruction ***text_pages; /* Text and kernel text */
+
+
 /* Memory-mapped IO area: */
 #define MM_IO_BOT		((mem_addr) 0xffff0000)
 #define MM_IO_TOP		((mem_addr) 0xffffffff)
@@ -87,6 +87,13 @@ extern reg_word CCR[4][32], CPR[4][32];
 #define CP0_Count_Reg	9
 #define CP0_Count	(CPR[0][CP0_Count_Reg]) /* ToDo */
 
+/* Instructions left until Count is next incremented (unless the timer
+   follows the wall clock): */
+extern int CP0_Count_cycles;
+
+/* Instructions executed since the registers were initialized: */
+extern int64 instructions_executed;
+
 /* Compare register: */
 #define CP0_Compare_Reg	11
 #define CP0_Compare	(CPR[0][CP0_Compare_Reg]) /* ToDo */
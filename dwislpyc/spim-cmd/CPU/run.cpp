@@ -61,6 +61,7 @@
 #include "parser_yacc.h"
 #include "syscall.h"
 #include "run.h"
+#include "jit.h"
 
 bool force_break = false;	/* For the execution env. to force an execution break */
 
@@ -72,7 +73,14 @@ bool force_break = false;	/* For the execution env. to force an execution break
 
 /* Local functions: */
 
+static void build_threaded_code ();
 static void bump_CP0_timer ();
+static void check_CP0_timer ();
+static void check_pending_interrupt ();
+static void decode_text ();
+static packed_inst *packed_slot (mem_addr addr);
+static void poll_CP0_timer ();
+static bool run_threaded (mem_addr initial_PC, int steps_to_run);
 static void set_fpu_cc (int cond, int cc, int less, int equal, int unordered);
 static void signed_multiply (reg_word v1, reg_word v2);
 static void start_CP0_timer ();
@@ -94,6 +102,9 @@ static void unsigned_multiply (reg_word v1, reg_word v2);
 slot of another instruction. */
 static int running_in_delay_slot = 0;
 
+/* True when run_threaded is using run_spim to execute one instruction. */
+static bool threaded_fallback = false;
+
 
 /* Executed delayed branch and jump instructions by running the
    instruction from the delay slot before transfering control.  Note,
@@ -188,11 +199,15 @@ static int running_in_delay_slot = 0;
 bool
 run_spim (mem_addr initial_PC, int steps_to_run, bool display)
 {
-  instruction *inst;
+  packed_inst *inst;
   static reg_word *delayed_load_addr1 = NULL, delayed_load_value1;
   static reg_word *delayed_load_addr2 = NULL, delayed_load_value2;
   int step, step_size, next_step;
 
+  if (threaded_code && !display && !delayed_branches && !delayed_loads
+      && !threaded_fallback)
+    return run_threaded (initial_PC, steps_to_run);
+
   PC = initial_PC;
   if (!bare_machine && mapped_io)
     next_step = IO_INTERVAL;
@@ -200,7 +215,8 @@ run_spim (mem_addr initial_PC, int steps_to_run, bool display)
     next_step = steps_to_run;	/* Run to completion */
 
   /* Start a timer running */
-  start_CP0_timer();
+  if (wall_clock_timer && !threaded_fallback)
+    start_CP0_timer();
 
   for (step_size = MIN (next_step, steps_to_run);
        steps_to_run > 0;
@@ -212,18 +228,7 @@ run_spim (mem_addr initial_PC, int steps_to_run, bool display)
 	check_memory_mapped_IO ();
       /* else run inner loop for all steps */
 
-      if ((CP0_Status & CP0_Status_IE)
-	  && !(CP0_Status & CP0_Status_EXL)
-	  && ((CP0_Cause & CP0_Cause_IP) & (CP0_Status & CP0_Status_IM)))
-	{
-	  /* There is an interrupt to process if IE bit set, EXL bit not
-	     set, and non-masked IP bit set */
-	  raise_exception (ExcCode_Int);
-	  /* Handle interrupt now, before instruction executes, so that
-	     EPC points to unexecuted instructions, which is the one to
-	     return to. */
-	  handle_exception ();
-	}
+      check_pending_interrupt ();
 
       force_break = false;
       for (step = 0; step < step_size; step += 1)
@@ -235,43 +240,35 @@ run_spim (mem_addr initial_PC, int steps_to_run, bool display)
 
 	  R[0] = 0;		/* Maintain invariant value */
 
-#ifdef _WIN32
-	  SleepEx(0, TRUE);	      /* Put thread in awaitable state for WaitableTimer */
-#else
-	  {
-	    /* Poll for timer expiration */
-	    struct itimerval time;
-	    if (-1 == getitimer (ITIMER_REAL, &time))
-	      {
-		perror ("getitmer failed");
-	      }
-	    if (time.it_value.tv_usec == 0 && time.it_value.tv_sec == 0)
-	      {
-		/* Timer expired */
-		bump_CP0_timer ();
+	  if (!threaded_fallback)
+	    {
+	      /* run_threaded accounts for the instructions it passes to
+		 run_spim. */
+	      check_CP0_timer ();
+	      if (!wall_clock_timer)
+		CP0_Count_cycles -= 1;
+	      instructions_executed += 1;
+	    }
 
-		/* Restart timer for next interval */
-                start_CP0_timer ();
-	      }
-	  }
-#endif
+	  if (text_modified)
+	    decode_text ();
 
 	  exception_occurred = 0;
-	  inst = read_mem_inst (PC);
-	  if (exception_occurred) /* In reading instruction */
+	  inst = packed_slot (PC);
+	  if (inst == NULL)
 	    {
+	      /* Not in a text segment */
+	      read_mem_inst (PC);
 	      exception_occurred = 0;
 	      handle_exception ();
 	      continue;
 	    }
-	  else if (inst == NULL)
+	  else if (inst->flags & PACKED_NOT_INST)
 	    {
 	      run_error ("Attempt to execute non-instruction at 0x%08x\n", PC);
 	      return false;
 	    }
-	  else if (EXPR (inst) != NULL
-		   && EXPR (inst)->symbol != NULL
-		   && EXPR (inst)->symbol->addr == 0)
+	  else if (inst->flags & PACKED_UNDEFINED)
 	    {
               run_error ("Instruction references undefined symbol at 0x%08x\n  %s", PC, inst_to_string(PC));
 	      return false;
@@ -281,7 +278,7 @@ run_spim (mem_addr initial_PC, int steps_to_run, bool display)
 	    print_inst (PC);
 
 #ifdef TEST_ASM
-	  test_assembly (inst);
+	  test_assembly (read_mem_inst (PC));
 #endif
 
 	  DO_DELAYED_UPDATE ();
@@ -1648,6 +1645,937 @@ run_spim (mem_addr initial_PC, int steps_to_run, bool display)
 }
 
 
+/* Packed text segments.
+
+   run_spim executes instructions from arrays of packed_inst, one per
+   word of each text segment, rather than following the pointers in the
+   text segments to the instructions.  The arrays, like the threaded
+   code, are rebuilt whenever the text segment is written. */
+
+static packed_inst *packed_text = NULL;
+static int packed_text_len = 0;
+static packed_inst *packed_k_text = NULL;
+static int packed_k_text_len = 0;
+
+
+/* Return the packed instruction at ADDR, or NULL if ADDR is not in a
+   text segment. */
+
+static inline packed_inst *
+packed_slot (mem_addr addr)
+{
+  if ((addr & 0x3) != 0)
+    return NULL;
+  else if ((addr >= TEXT_BOT) && (addr < text_top))
+    return &packed_text [(addr - TEXT_BOT) >> 2];
+  else if ((addr >= K_TEXT_BOT) && (addr < k_text_top))
+    return &packed_k_text [(addr - K_TEXT_BOT) >> 2];
+  else
+    return NULL;
+}
+
+
+/* Pack the N instructions of text segment SEG into PACKED, which holds
+   *LEN instructions, and return the new array. */
+
+static packed_inst *
+pack_segment (packed_inst *packed, int *len, instruction **seg, int n)
+{
+  int i;
+
+  if (packed == NULL || *len != n)
+    {
+      if (packed != NULL)
+	free (packed);
+      packed = (packed_inst *) xmalloc (n * sizeof (packed_inst));
+      *len = n;
+    }
+
+  for (i = 0; i < n; i += 1)
+    {
+      instruction *inst = seg [i];
+
+      if (inst == NULL)
+	{
+	  memclr (&packed [i], sizeof (packed_inst));
+	  packed [i].flags = PACKED_NOT_INST;
+	  continue;
+	}
+      packed [i].opcode = OPCODE (inst);
+      packed [i].r_t = inst->r_t;
+      packed [i].flags = 0;
+      if (EXPR (inst) != NULL
+	  && EXPR (inst)->symbol != NULL
+	  && EXPR (inst)->symbol->addr == 0)
+	packed [i].flags |= PACKED_UNDEFINED;
+    }
+  return packed;
+}
+
+
+/* Rebuild the packed instructions (and threaded code) after the text
+   segment changed. */
+
+static void
+decode_text ()
+{
+  packed_text = pack_segment (packed_text, &packed_text_len, text_seg,
+			      (text_top - TEXT_BOT) / BYTES_PER_WORD);
+  packed_k_text = pack_segment (packed_k_text, &packed_k_text_len,
+				k_text_seg,
+				(k_text_top - K_TEXT_BOT) / BYTES_PER_WORD);
+  if (threaded_code)
+    build_threaded_code ();
+
+  text_modified = false;
+}
+
+
+
+/* Threaded-code execution.
+
+   Instead of fetching each instruction from the text segment and
+   dispatching on its opcode, run_threaded executes a parallel array of
+   pre-decoded slots, one per word of each text segment.  A slot holds
+   a pointer to the function that executes the instruction, its operand
+   fields, and (for branches and jumps) a pointer to the target slot.
+   Each function returns the next slot to execute, or NULL to leave the
+   inner loop.
+
+   Checks that depend only on the program text -- a missing instruction,
+   a reference to an undefined symbol, a write to register $0, a branch
+   out of the text segments -- are made once, when the slot is built.
+   Instructions that fail them, and opcodes without a function of their
+   own, are executed by the switch in run_spim.  The slots are rebuilt
+   whenever the text segment is written. */
+
+typedef struct threaded_inst threaded_inst;
+
+typedef threaded_inst *(*threaded_fn) (threaded_inst *ti);
+
+struct threaded_inst
+{
+  threaded_fn fn;		/* Function that executes instruction */
+  mem_addr addr;		/* Address of instruction */
+  reg_word imm;			/* Immediate, extended as opcode needs */
+  threaded_inst *target;	/* Slot of branch or jump target */
+  unsigned char rs, rt, rd, shamt;
+};
+
+
+/* Slots for the user and kernel text segments. Each has an extra slot
+   at the end, so falling off the end of a segment is caught. */
+
+static threaded_inst *threaded_text = NULL;
+static int threaded_text_len = 0;
+static threaded_inst *threaded_k_text = NULL;
+static int threaded_k_text_len = 0;
+
+/* Slot used for addresses that are not in a text segment. */
+
+static threaded_inst threaded_escape;
+
+/* Set by a function that returns NULL to stop execution.  RUN_THREADED
+   returns THREADED_RESULT. */
+
+static bool threaded_stop;
+static bool threaded_result;
+
+/* Number of instructions left in the run of instructions that
+   run_threaded is executing, including the current one. */
+
+static int threaded_left;
+
+
+/* Return the slot for the instruction at ADDR. */
+
+static inline threaded_inst *
+threaded_slot (mem_addr addr)
+{
+  if ((addr & 0x3) == 0)
+    {
+      if ((addr >= TEXT_BOT) && (addr < text_top))
+	return &threaded_text [(addr - TEXT_BOT) >> 2];
+      else if ((addr >= K_TEXT_BOT) && (addr < k_text_top))
+	return &threaded_k_text [(addr - K_TEXT_BOT) >> 2];
+    }
+  threaded_escape.addr = addr;
+  return &threaded_escape;
+}
+
+
+/* Leave the inner loop so that the slots can be rebuilt if the last
+   instruction wrote into the text segment. Otherwise, continue with
+   NEXT. */
+
+static inline threaded_inst *
+threaded_check_text (threaded_inst *next)
+{
+  if (text_modified)
+    {
+      PC = next->addr;
+      return NULL;
+    }
+  return next;
+}
+
+
+/* Handle an exception raised by the instruction in slot TI and continue
+   with the exception handler. */
+
+static threaded_inst *
+threaded_exception ()
+{
+  handle_exception ();
+  return threaded_slot (PC);
+}
+
+
+/* Execute the instruction in slot TI with the switch in run_spim. */
+
+static threaded_inst *
+t_switch (threaded_inst *ti)
+{
+  bool continuable;
+
+  threaded_fallback = true;
+  continuable = run_spim (ti->addr, 1, false);
+  threaded_fallback = false;
+  R[0] = 0;			/* Instruction may have written $0 */
+
+  if (!continuable || exception_occurred)
+    {
+      /* Program exited or stopped at a breakpoint */
+      threaded_stop = true;
+      threaded_result = continuable;
+      return NULL;
+    }
+  return threaded_check_text (threaded_slot (PC));
+}
+
+
+static threaded_inst *
+t_nop (threaded_inst *ti)
+{
+  return ti + 1;
+}
+
+
+/* Instructions that only write a general register.  Slots whose
+   destination is $0 use t_nop instead. */
+
+#define THREADED_ALU(NAME, DEST, VALUE)			\
+static threaded_inst *					\
+NAME (threaded_inst *ti)				\
+{							\
+  R[ti->DEST] = (VALUE);				\
+  return ti + 1;					\
+}
+
+THREADED_ALU (t_addiu, rt, R[ti->rs] + ti->imm)
+THREADED_ALU (t_addu, rd, R[ti->rs] + R[ti->rt])
+THREADED_ALU (t_and, rd, R[ti->rs] & R[ti->rt])
+THREADED_ALU (t_andi, rt, R[ti->rs] & ti->imm)
+THREADED_ALU (t_lui, rt, ti->imm)
+THREADED_ALU (t_mfhi, rd, HI)
+THREADED_ALU (t_mflo, rd, LO)
+THREADED_ALU (t_nor, rd, ~ (R[ti->rs] | R[ti->rt]))
+THREADED_ALU (t_or, rd, R[ti->rs] | R[ti->rt])
+THREADED_ALU (t_ori, rt, R[ti->rs] | ti->imm)
+THREADED_ALU (t_sll, rd, R[ti->rt] << ti->shamt)
+THREADED_ALU (t_sllv, rd, R[ti->rt] << (R[ti->rs] & 0x1f))
+THREADED_ALU (t_slt, rd, R[ti->rs] < R[ti->rt])
+THREADED_ALU (t_slti, rt, R[ti->rs] < ti->imm)
+THREADED_ALU (t_sltiu, rt, (u_reg_word) R[ti->rs] < (u_reg_word) ti->imm)
+THREADED_ALU (t_sltu, rd, (u_reg_word) R[ti->rs] < (u_reg_word) R[ti->rt])
+THREADED_ALU (t_sra, rd, R[ti->rt] >> ti->shamt)
+THREADED_ALU (t_srav, rd, R[ti->rt] >> (R[ti->rs] & 0x1f))
+THREADED_ALU (t_srl, rd, (u_reg_word) R[ti->rt] >> ti->shamt)
+THREADED_ALU (t_srlv, rd, (u_reg_word) R[ti->rt] >> (R[ti->rs] & 0x1f))
+THREADED_ALU (t_subu, rd, (u_reg_word) R[ti->rs] - (u_reg_word) R[ti->rt])
+THREADED_ALU (t_xor, rd, R[ti->rs] ^ R[ti->rt])
+THREADED_ALU (t_xori, rt, R[ti->rs] ^ ti->imm)
+
+
+static threaded_inst *
+t_add (threaded_inst *ti)
+{
+  reg_word vs = R[ti->rs], vt = R[ti->rt];
+  reg_word sum = vs + vt;
+
+  if (ARITH_OVFL (sum, vs, vt))
+    {
+      PC = ti->addr;
+      RAISE_EXCEPTION (ExcCode_Ov, return threaded_exception ());
+    }
+  R[ti->rd] = sum;
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_addi (threaded_inst *ti)
+{
+  reg_word vs = R[ti->rs], imm = ti->imm;
+  reg_word sum = vs + imm;
+
+  if (ARITH_OVFL (sum, vs, imm))
+    {
+      PC = ti->addr;
+      RAISE_EXCEPTION (ExcCode_Ov, return threaded_exception ());
+    }
+  R[ti->rt] = sum;
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_sub (threaded_inst *ti)
+{
+  reg_word vs = R[ti->rs], vt = R[ti->rt];
+  reg_word diff = vs - vt;
+
+  if (SIGN_BIT (vs) != SIGN_BIT (vt)
+      && SIGN_BIT (vs) != SIGN_BIT (diff))
+    {
+      PC = ti->addr;
+      RAISE_EXCEPTION (ExcCode_Ov, return threaded_exception ());
+    }
+  R[ti->rd] = diff;
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_mul (threaded_inst *ti)
+{
+  signed_multiply (R[ti->rs], R[ti->rt]);
+  R[ti->rd] = LO;
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_mult (threaded_inst *ti)
+{
+  signed_multiply (R[ti->rs], R[ti->rt]);
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_multu (threaded_inst *ti)
+{
+  unsigned_multiply (R[ti->rs], R[ti->rt]);
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_div (threaded_inst *ti)
+{
+  /* The behavior of this instruction is undefined on divide by zero or
+     overflow. */
+  if (R[ti->rt] != 0
+      && !(R[ti->rs] == (reg_word)0x80000000
+	   && R[ti->rt] == (reg_word)0xffffffff))
+    {
+      LO = (reg_word) R[ti->rs] / (reg_word) R[ti->rt];
+      HI = (reg_word) R[ti->rs] % (reg_word) R[ti->rt];
+    }
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_divu (threaded_inst *ti)
+{
+  if (R[ti->rt] != 0
+      && !(R[ti->rs] == (reg_word)0x80000000
+	   && R[ti->rt] == (reg_word)0xffffffff))
+    {
+      LO = (u_reg_word) R[ti->rs] / (u_reg_word) R[ti->rt];
+      HI = (u_reg_word) R[ti->rs] % (u_reg_word) R[ti->rt];
+    }
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_mthi (threaded_inst *ti)
+{
+  HI = R[ti->rs];
+  return ti + 1;
+}
+
+
+static threaded_inst *
+t_mtlo (threaded_inst *ti)
+{
+  LO = R[ti->rs];
+  return ti + 1;
+}
+
+
+/* Branches. The target slot was found when the slot was built. */
+
+#define THREADED_BRANCH(NAME, TEST)			\
+static threaded_inst *					\
+NAME (threaded_inst *ti)				\
+{							\
+  return (TEST) ? ti->target : ti + 1;			\
+}
+
+THREADED_BRANCH (t_beq, R[ti->rs] == R[ti->rt])
+THREADED_BRANCH (t_bne, R[ti->rs] != R[ti->rt])
+THREADED_BRANCH (t_bgez, SIGN_BIT (R[ti->rs]) == 0)
+THREADED_BRANCH (t_bgtz, R[ti->rs] != 0 && SIGN_BIT (R[ti->rs]) == 0)
+THREADED_BRANCH (t_blez, R[ti->rs] == 0 || SIGN_BIT (R[ti->rs]) != 0)
+THREADED_BRANCH (t_bltz, SIGN_BIT (R[ti->rs]) != 0)
+
+
+static threaded_inst *
+t_bgezal (threaded_inst *ti)
+{
+  R[31] = ti->addr + BYTES_PER_WORD;
+  return SIGN_BIT (R[ti->rs]) == 0 ? ti->target : ti + 1;
+}
+
+
+static threaded_inst *
+t_bltzal (threaded_inst *ti)
+{
+  R[31] = ti->addr + BYTES_PER_WORD;
+  return SIGN_BIT (R[ti->rs]) != 0 ? ti->target : ti + 1;
+}
+
+
+static threaded_inst *
+t_j (threaded_inst *ti)
+{
+  return ti->target;
+}
+
+
+static threaded_inst *
+t_jal (threaded_inst *ti)
+{
+  R[31] = ti->addr + BYTES_PER_WORD;
+  return ti->target;
+}
+
+
+static threaded_inst *
+t_jalr (threaded_inst *ti)
+{
+  mem_addr tmp = R[ti->rs];
+
+  R[ti->rd] = ti->addr + BYTES_PER_WORD;
+  return threaded_slot (tmp);
+}
+
+
+static threaded_inst *
+t_jr (threaded_inst *ti)
+{
+  return threaded_slot (R[ti->rs]);
+}
+
+
+/* Loads and stores. PC must be correct in case the access raises an
+   exception. As in run_spim, a load writes its destination even if
+   the access fails. */
+
+#define THREADED_LOAD(NAME, READ, MASK)			\
+static threaded_inst *					\
+NAME (threaded_inst *ti)				\
+{							\
+  PC = ti->addr;					\
+  R[ti->rt] = READ (R[ti->rs] + ti->imm) & (MASK);	\
+  if (exception_occurred)				\
+    return threaded_exception ();			\
+  return ti + 1;					\
+}
+
+THREADED_LOAD (t_lb, read_mem_byte, 0xffffffff)
+THREADED_LOAD (t_lbu, read_mem_byte, 0xff)
+THREADED_LOAD (t_lh, read_mem_half, 0xffffffff)
+THREADED_LOAD (t_lhu, read_mem_half, 0xffff)
+THREADED_LOAD (t_lw, read_mem_word, 0xffffffff)
+
+
+#define THREADED_STORE(NAME, WRITE)			\
+static threaded_inst *					\
+NAME (threaded_inst *ti)				\
+{							\
+  PC = ti->addr;					\
+  WRITE (R[ti->rs] + ti->imm, R[ti->rt]);		\
+  if (exception_occurred)				\
+    return threaded_exception ();			\
+  return threaded_check_text (ti + 1);			\
+}
+
+THREADED_STORE (t_sb, set_mem_byte)
+THREADED_STORE (t_sh, set_mem_half)
+THREADED_STORE (t_sw, set_mem_word)
+
+
+/* Superinstructions.
+
+   The DWISLPY compiler keeps most variables in registers, so few of its
+   instructions touch the stack frame.  Those that do come in a few
+   fixed sequences: an operation on variables that register allocation
+   spilled to the frame, such as
+
+	lw $t1, a($fp); lw $t2, b($fp); add $t0, $t1, $t2; sw $t0, c($fp)
+
+   or a constant stored into a spilled slot, la or li followed by sw.
+   These only show up in code under heavy register pressure, and in
+   hand-written code that keeps its variables in memory.  When the slots
+   are built, the first slot of such a sequence gets a function that
+   executes the whole sequence, saving the dispatch of the others.  The
+   other slots keep their own functions, so a branch into the sequence,
+   or a run that ends in the middle of it, executes the instructions one
+   at a time.  A sequence stops early, as the instructions would, on an
+   exception.  Only the slots that hold assembled code are searched for
+   them, so code that has none pays almost nothing. */
+
+static threaded_inst *
+t_lw_lw_op_sw (threaded_inst *ti)
+{
+  threaded_inst *next;
+
+  if (threaded_left < 4)
+    return t_lw (ti);
+
+  if ((next = t_lw (ti)) != ti + 1)
+    return next;
+  threaded_left -= 1;
+  if ((next = t_lw (ti + 1)) != ti + 2)
+    return next;
+  threaded_left -= 1;
+  if ((next = ti[2].fn (ti + 2)) != ti + 3)
+    return next;
+  threaded_left -= 1;
+  return t_sw (ti + 3);
+}
+
+
+static threaded_inst *
+t_lw_op_sw (threaded_inst *ti)
+{
+  threaded_inst *next;
+
+  if (threaded_left < 3)
+    return t_lw (ti);
+
+  if ((next = t_lw (ti)) != ti + 1)
+    return next;
+  threaded_left -= 1;
+  if ((next = ti[1].fn (ti + 1)) != ti + 2)
+    return next;
+  threaded_left -= 1;
+  return t_sw (ti + 2);
+}
+
+
+static threaded_inst *
+t_lui_ori_sw (threaded_inst *ti)
+{
+  if (threaded_left < 3)
+    return t_lui (ti);
+
+  t_lui (ti);
+  t_ori (ti + 1);
+  threaded_left -= 2;
+  return t_sw (ti + 2);
+}
+
+
+static threaded_inst *
+t_lui_sw (threaded_inst *ti)
+{
+  if (threaded_left < 2)
+    return t_lui (ti);
+
+  t_lui (ti);
+  threaded_left -= 1;
+  return t_sw (ti + 1);
+}
+
+
+static threaded_inst *
+t_ori_sw (threaded_inst *ti)
+{
+  if (threaded_left < 2)
+    return t_ori (ti);
+
+  t_ori (ti);
+  threaded_left -= 1;
+  return t_sw (ti + 1);
+}
+
+
+static threaded_inst *
+t_syscall (threaded_inst *ti)
+{
+  PC = ti->addr;
+  if (!do_syscall ())
+    {
+      threaded_stop = true;
+      threaded_result = false;
+      return NULL;
+    }
+  if (exception_occurred)
+    return threaded_exception ();
+  return threaded_check_text (ti + 1);
+}
+
+
+/* Return the slot for a branch or jump to ADDR, or NULL if ADDR is not
+   an instruction in a text segment. */
+
+static threaded_inst *
+threaded_target (mem_addr addr)
+{
+  if ((addr & 0x3) != 0)
+    return NULL;
+  else if ((addr >= TEXT_BOT) && (addr < text_top))
+    return &threaded_text [(addr - TEXT_BOT) >> 2];
+  else if ((addr >= K_TEXT_BOT) && (addr < k_text_top))
+    return &threaded_k_text [(addr - K_TEXT_BOT) >> 2];
+  else
+    return NULL;
+}
+
+
+/* Fill in slot TI for instruction INST at address ADDR. */
+
+static void
+decode_threaded_inst (threaded_inst *ti, instruction *inst, mem_addr addr)
+{
+  ti->fn = t_switch;
+  ti->addr = addr;
+  ti->target = NULL;
+  ti->imm = 0;
+  ti->rs = ti->rt = ti->rd = ti->shamt = 0;
+
+  if (inst == NULL
+      || (EXPR (inst) != NULL
+	  && EXPR (inst)->symbol != NULL
+	  && EXPR (inst)->symbol->addr == 0))
+    return;			/* run_spim reports the error */
+
+  ti->rs = RS (inst);
+  ti->rt = RT (inst);
+  ti->rd = RD (inst);
+  ti->shamt = SHAMT (inst) < 32 ? SHAMT (inst) : 0;
+  ti->imm = (short) IMM (inst);
+
+/* Use FN for an instruction that only writes register DEST. */
+#define ALU_SLOT(FN, DEST) ti->fn = (ti->DEST != 0 ? FN : t_nop)
+/* Use FN for an instruction that writes register DEST and might raise an
+   exception, unless DEST is $0. */
+#define CHECKED_SLOT(FN, DEST) if (ti->DEST != 0) ti->fn = FN
+/* Use FN for a branch or jump to TARGET_ADDR within the text segments. */
+#define BRANCH_SLOT(FN, TARGET_ADDR)				\
+  if ((ti->target = threaded_target (TARGET_ADDR)) != NULL)	\
+    ti->fn = FN
+
+  switch (OPCODE (inst))
+    {
+    case Y_ADD_OP: CHECKED_SLOT (t_add, rd); break;
+    case Y_ADDI_OP: CHECKED_SLOT (t_addi, rt); break;
+    case Y_ADDIU_OP: ALU_SLOT (t_addiu, rt); break;
+    case Y_ADDU_OP: ALU_SLOT (t_addu, rd); break;
+    case Y_AND_OP: ALU_SLOT (t_and, rd); break;
+    case Y_ANDI_OP: ti->imm &= 0xffff; ALU_SLOT (t_andi, rt); break;
+    case Y_BEQ_OP: BRANCH_SLOT (t_beq, addr + IDISP (inst)); break;
+    case Y_BGEZ_OP: BRANCH_SLOT (t_bgez, addr + IDISP (inst)); break;
+    case Y_BGEZAL_OP: BRANCH_SLOT (t_bgezal, addr + IDISP (inst)); break;
+    case Y_BGTZ_OP: BRANCH_SLOT (t_bgtz, addr + IDISP (inst)); break;
+    case Y_BLEZ_OP: BRANCH_SLOT (t_blez, addr + IDISP (inst)); break;
+    case Y_BLTZ_OP: BRANCH_SLOT (t_bltz, addr + IDISP (inst)); break;
+    case Y_BLTZAL_OP: BRANCH_SLOT (t_bltzal, addr + IDISP (inst)); break;
+    case Y_BNE_OP: BRANCH_SLOT (t_bne, addr + IDISP (inst)); break;
+    case Y_DIV_OP: ti->fn = t_div; break;
+    case Y_DIVU_OP: ti->fn = t_divu; break;
+    case Y_J_OP:
+      BRANCH_SLOT (t_j, (addr & 0xf0000000) | TARGET (inst) << 2);
+      break;
+    case Y_JAL_OP:
+      BRANCH_SLOT (t_jal, (addr & 0xf0000000) | TARGET (inst) << 2);
+      break;
+    case Y_JALR_OP: CHECKED_SLOT (t_jalr, rd); break;
+    case Y_JR_OP: ti->fn = t_jr; break;
+    case Y_LB_OP: CHECKED_SLOT (t_lb, rt); break;
+    case Y_LBU_OP: CHECKED_SLOT (t_lbu, rt); break;
+    case Y_LH_OP: CHECKED_SLOT (t_lh, rt); break;
+    case Y_LHU_OP: CHECKED_SLOT (t_lhu, rt); break;
+    case Y_LUI_OP:
+      ti->imm = (IMM (inst) << 16) & 0xffff0000;
+      ALU_SLOT (t_lui, rt);
+      break;
+    case Y_LW_OP: CHECKED_SLOT (t_lw, rt); break;
+    case Y_MFHI_OP: ALU_SLOT (t_mfhi, rd); break;
+    case Y_MFLO_OP: ALU_SLOT (t_mflo, rd); break;
+    case Y_MTHI_OP: ti->fn = t_mthi; break;
+    case Y_MTLO_OP: ti->fn = t_mtlo; break;
+    case Y_MUL_OP: CHECKED_SLOT (t_mul, rd); break;
+    case Y_MULT_OP: ti->fn = t_mult; break;
+    case Y_MULTU_OP: ti->fn = t_multu; break;
+    case Y_NOR_OP: ALU_SLOT (t_nor, rd); break;
+    case Y_OR_OP: ALU_SLOT (t_or, rd); break;
+    case Y_ORI_OP: ti->imm &= 0xffff; ALU_SLOT (t_ori, rt); break;
+    case Y_SB_OP: ti->fn = t_sb; break;
+    case Y_SH_OP: ti->fn = t_sh; break;
+    case Y_SLL_OP: ALU_SLOT (t_sll, rd); break;
+    case Y_SLLV_OP: ALU_SLOT (t_sllv, rd); break;
+    case Y_SLT_OP: ALU_SLOT (t_slt, rd); break;
+    case Y_SLTI_OP: ALU_SLOT (t_slti, rt); break;
+    case Y_SLTIU_OP: ALU_SLOT (t_sltiu, rt); break;
+    case Y_SLTU_OP: ALU_SLOT (t_sltu, rd); break;
+    case Y_SRA_OP: ALU_SLOT (t_sra, rd); break;
+    case Y_SRAV_OP: ALU_SLOT (t_srav, rd); break;
+    case Y_SRL_OP: ALU_SLOT (t_srl, rd); break;
+    case Y_SRLV_OP: ALU_SLOT (t_srlv, rd); break;
+    case Y_SUB_OP: CHECKED_SLOT (t_sub, rd); break;
+    case Y_SUBU_OP: ALU_SLOT (t_subu, rd); break;
+    case Y_SW_OP: ti->fn = t_sw; break;
+    case Y_SYSCALL_OP: ti->fn = t_syscall; break;
+    case Y_XOR_OP: ALU_SLOT (t_xor, rd); break;
+    case Y_XORI_OP: ti->imm &= 0xffff; ALU_SLOT (t_xori, rt); break;
+    default: break;		/* Everything else uses the switch */
+    }
+
+#undef ALU_SLOT
+#undef CHECKED_SLOT
+#undef BRANCH_SLOT
+}
+
+
+/* Return true if FN executes a register-register ALU instruction, which
+   continues with the next slot unless it raises an exception. */
+
+static bool
+fusable_op (threaded_fn fn)
+{
+  return (fn == t_add || fn == t_addu || fn == t_and || fn == t_nor
+	  || fn == t_or || fn == t_slt || fn == t_sltu || fn == t_sub
+	  || fn == t_subu || fn == t_xor);
+}
+
+
+/* Replace the function in the first slot of each sequence of the N
+   slots at TI that has a superinstruction. */
+
+static void
+fuse_threaded_code (threaded_inst *ti, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i += 1)
+    {
+      threaded_fn fn = ti[i].fn;
+
+      if (fn == t_lw && i + 3 < n && ti[i + 1].fn == t_lw
+	  && fusable_op (ti[i + 2].fn) && ti[i + 3].fn == t_sw)
+	ti[i].fn = t_lw_lw_op_sw;
+      else if (fn == t_lw && i + 2 < n && fusable_op (ti[i + 1].fn)
+	       && ti[i + 2].fn == t_sw)
+	ti[i].fn = t_lw_op_sw;
+      else if (fn == t_lui && i + 2 < n && ti[i + 1].fn == t_ori
+	       && ti[i + 2].fn == t_sw)
+	ti[i].fn = t_lui_ori_sw;
+      else if (fn == t_lui && i + 1 < n && ti[i + 1].fn == t_sw)
+	ti[i].fn = t_lui_sw;
+      else if (fn == t_ori && i + 1 < n && ti[i + 1].fn == t_sw)
+	ti[i].fn = t_ori_sw;
+    }
+}
+
+
+/* Allocate the slots for a text segment of SIZE bytes. */
+
+static threaded_inst *
+alloc_threaded_segment (threaded_inst *slots, int *len, int size)
+{
+  int n = size / BYTES_PER_WORD + 1;
+
+  if (slots == NULL || *len != n)
+    {
+      if (slots != NULL)
+	free (slots);
+      slots = (threaded_inst *) xmalloc (n * sizeof (threaded_inst));
+      *len = n;
+    }
+  return slots;
+}
+
+
+/* Build the slots for the user and kernel text segments. */
+
+static void
+build_threaded_code ()
+{
+  int i;
+  int text_used = 0;		/* Slots up to the last instruction */
+
+  /* Allocate both segments first, so branches can find their targets in
+     either. */
+  threaded_text = alloc_threaded_segment (threaded_text, &threaded_text_len,
+					  text_top - TEXT_BOT);
+  threaded_k_text = alloc_threaded_segment (threaded_k_text,
+					    &threaded_k_text_len,
+					    k_text_top - K_TEXT_BOT);
+
+  for (i = 0; i < threaded_text_len - 1; i += 1)
+    {
+      decode_threaded_inst (&threaded_text [i], text_seg [i],
+			    TEXT_BOT + i * BYTES_PER_WORD);
+      if (text_seg [i] != NULL)
+	text_used = i + 1;
+    }
+  decode_threaded_inst (&threaded_text [i], NULL, text_top);
+
+  for (i = 0; i < threaded_k_text_len - 1; i += 1)
+    decode_threaded_inst (&threaded_k_text [i], k_text_seg [i],
+			  K_TEXT_BOT + i * BYTES_PER_WORD);
+  decode_threaded_inst (&threaded_k_text [i], NULL, k_text_top);
+
+  decode_threaded_inst (&threaded_escape, NULL, 0);
+
+  if (jit_code && !jit_reset ())
+    jit_code = false;		/* No compiler for this machine */
+
+  /* Compiled blocks are entered on a control transfer, which run_jit
+     detects by a slot that does not follow the previous one, so
+     superinstructions are only used without the compiler.  Kernel
+     code is left alone, so a sequence never runs into the exception
+     handler's slot. */
+  if (!jit_code)
+    fuse_threaded_code (threaded_text, text_used);
+}
+
+
+/* Execute at most SLICE instructions starting at slot TI, running
+   compiled code for the blocks that the JIT has compiled. Set *EXECUTED
+   to the number of instructions executed and return the next slot, as
+   the loop in run_threaded does. */
+
+static threaded_inst *
+run_jit (threaded_inst *ti, int slice, int *executed)
+{
+  threaded_inst *prev = NULL;
+  int n = 0, k;
+
+  while (n < slice && ti != NULL)
+    {
+      /* Blocks are only entered by a control transfer. */
+      if (ti != prev + 1
+	  && (k = jit_execute (ti->addr, slice - n)) > 0)
+	{
+	  n += k;
+	  prev = NULL;
+	  if (exception_occurred)
+	    ti = threaded_exception ();
+	  else if (text_modified)
+	    ti = NULL;		/* PC is next instruction */
+	  else
+	    ti = threaded_slot (PC);
+	  continue;
+	}
+
+      prev = ti;
+      ti = ti->fn (ti);
+      n += 1;
+    }
+
+  *executed = n;
+  return ti;
+}
+
+
+/* Run the program as run_spim does, but execute threaded code. */
+
+static bool
+run_threaded (mem_addr initial_PC, int steps_to_run)
+{
+  threaded_inst *ti;
+  int step, step_size, next_step, slice, n;
+
+  PC = initial_PC;
+  if (!bare_machine && mapped_io)
+    next_step = IO_INTERVAL;
+  else
+    next_step = steps_to_run;	/* Run to completion */
+
+  /* Start a timer running */
+  if (wall_clock_timer && !threaded_fallback)
+    start_CP0_timer();
+
+  for (step_size = MIN (next_step, steps_to_run);
+       steps_to_run > 0;
+       steps_to_run -= step_size, step_size = MIN (next_step, steps_to_run))
+    {
+      if (!bare_machine && mapped_io)
+	/* Every IO_INTERVAL steps, check if memory-mapped IO registers
+	   have changed. */
+	check_memory_mapped_IO ();
+
+      check_pending_interrupt ();
+
+      force_break = false;
+      for (step = 0; step < step_size; step += n)
+	{
+	  if (force_break)
+	    {
+	      return true;
+	    }
+
+	  /* The timer is checked every THREADED_POLL_INTERVAL instructions,
+	     rather than before every instruction. A run of instructions
+	     never passes the next timer tick, so the Count register is
+	     bumped before the same instruction as in run_spim. */
+	  check_CP0_timer ();
+
+	  if (text_modified)
+	    decode_text ();
+
+	  R[0] = 0;		/* Maintain invariant value */
+	  exception_occurred = 0;
+	  threaded_stop = false;
+
+	  slice = MIN (THREADED_POLL_INTERVAL, step_size - step);
+	  if (!wall_clock_timer)
+	    slice = MIN (slice, CP0_Count_cycles);
+	  if (jit_code)
+	    ti = run_jit (threaded_slot (PC), slice, &n);
+	  else
+	    {
+	      threaded_left = slice;
+	      for (ti = threaded_slot (PC);
+		   threaded_left > 0 && ti != NULL;
+		   threaded_left -= 1)
+		ti = ti->fn (ti);
+	      n = slice - threaded_left;
+	    }
+	  if (!wall_clock_timer)
+	    CP0_Count_cycles -= n;
+	  instructions_executed += n;
+
+	  if (ti != NULL)
+	    PC = ti->addr;
+	  else if (threaded_stop)
+	    return threaded_result;
+	}
+    }
+
+  /* Executed enought steps, return, but are able to continue. */
+  return true;
+}
+
+
 #ifdef _WIN32
 void CALLBACK
 timer_completion_routine(LPVOID lpArgToCompletionRoutine, DWORD dwTimerLowValue, DWORD dwTimerHighValue)
@@ -1660,6 +2588,71 @@ timer_completion_routine(LPVOID lpArgToCompletionRoutine, DWORD dwTimerLowValue,
 #endif
 
 
+/* Raise and handle an interrupt if one is pending and enabled. */
+
+static void
+check_pending_interrupt ()
+{
+  if ((CP0_Status & CP0_Status_IE)
+      && !(CP0_Status & CP0_Status_EXL)
+      && ((CP0_Cause & CP0_Cause_IP) & (CP0_Status & CP0_Status_IM)))
+    {
+      /* There is an interrupt to process if IE bit set, EXL bit not
+	 set, and non-masked IP bit set */
+      raise_exception (ExcCode_Int);
+      /* Handle interrupt now, before instruction executes, so that
+	 EPC points to unexecuted instructions, which is the one to
+	 return to. */
+      handle_exception ();
+    }
+}
+
+
+/* Bump the CP0 Count register if the timer interval has elapsed. The
+   interval is TIMER_TICK_CYCLES instructions, counted down in
+   CP0_Count_cycles by the interpreter loops, or TIMER_TICK_MS of real
+   time if wall_clock_timer is set. */
+
+static void
+check_CP0_timer ()
+{
+  if (wall_clock_timer)
+    poll_CP0_timer ();
+  else if (CP0_Count_cycles <= 0)
+    {
+      CP0_Count_cycles += TIMER_TICK_CYCLES;
+      bump_CP0_timer ();
+    }
+}
+
+
+/* Check whether the CP0 timer interval has elapsed and, if so, bump
+   the Count register and restart the timer. */
+
+static void
+poll_CP0_timer ()
+{
+#ifdef _WIN32
+  SleepEx(0, TRUE);	      /* Put thread in awaitable state for WaitableTimer */
+#else
+  /* Poll for timer expiration */
+  struct itimerval time;
+  if (-1 == getitimer (ITIMER_REAL, &time))
+    {
+      perror ("getitmer failed");
+    }
+  if (time.it_value.tv_usec == 0 && time.it_value.tv_sec == 0)
+    {
+      /* Timer expired */
+      bump_CP0_timer ();
+
+      /* Restart timer for next interval */
+      start_CP0_timer ();
+    }
+#endif
+}
+
+
 /* Increment CP0 Count register and test if it matches the Compare
    register. If so, cause an interrupt. */
 
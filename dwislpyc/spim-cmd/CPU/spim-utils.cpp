@@ -167,6 +167,8 @@ initialize_registers ()
 
   CP0_BadVAddr = 0;
   CP0_Count = 0;
+  CP0_Count_cycles = TIMER_TICK_CYCLES;
+  instructions_executed = 0;
   CP0_Compare = 0;
   CP0_Status = (CP0_Status_CU & 0x30000000) | CP0_Status_IM | CP0_Status_UM;
   CP0_Cause = 0;
@@ -50,6 +50,7 @@
 
 typedef int int32;
 typedef unsigned int  uint32;
+typedef long long int64;
 typedef union {int i; void* p;} intptr_union;
 
 
@@ -211,10 +212,23 @@ typedef uint32 /*@alt int @*/ mem_addr;
 #define TRANS_LATENCY 100
 
 
+/* Maximum number of instructions that threaded code executes between
+   checks of the CP0 timer and of force_break. */
+
+#define THREADED_POLL_INTERVAL 1024
+
+
 /* Iterval (milliseconds) for the hardware timer in CP0. */
 
 #define TIMER_TICK_MS 10	/* 100 times per second */
 
+
+/* Interval (instructions executed) for the hardware timer in CP0, unless
+   it follows the wall clock. This is roughly TIMER_TICK_MS for the
+   decoding interpreter. */
+
+#define TIMER_TICK_CYCLES 40000
+
 
 
 /* A port is either a Unix file descriptor (an int) or a FILE* pointer. */
@@ -250,6 +264,9 @@ extern int spim_return_value;     /* Value returned when spim exits */
 /* Actual type of structure pointed to depends on X/terminal interface */
 extern port message_out, console_out, console_in;
 extern bool mapped_io;		/* => activate memory-mapped IO */
+extern bool threaded_code;	/* => execute pre-decoded threaded code */
+extern bool jit_code;		/* => compile hot blocks to machine code */
+extern bool wall_clock_timer;	/* => CP0 timer follows real time */
 extern int initial_text_size;
 extern int initial_data_size;
 extern mem_addr initial_data_limit;
@@ -303,6 +303,7 @@ resolve_a_label_sub (label *sym, instruction *inst, mem_addr pc)
   else
     {
       /* Instruction: */
+      text_modified = true;	/* Patched instruction must be re-decoded */
       if (EXPR (inst)->pc_relative)
 	EXPR (inst)->offset = 0 - pc; /* Instruction may have moved */
 
@@ -446,6 +447,20 @@ find_symbol_address (char *symbol)
 }
 
 
+/* Call FN with each label in the table and ARG. */
+
+void
+map_labels (void (*fn) (label *, void *), void *arg)
+{
+  int i;
+  label *l;
+
+  for (i = 0; i < LABEL_HASH_TABLE_SIZE; i ++)
+    for (l = label_hash_table [i]; l != NULL; l = l->next)
+      fn (l, arg);
+}
+
+
 /* Print all symbols in the table. */
 
 void
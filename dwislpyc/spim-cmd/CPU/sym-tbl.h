@@ -66,6 +66,7 @@ void initialize_symbol_table ();
 label *label_is_defined (char *name);
 label *lookup_label (char *name);
 label *make_label_global (char *name);
+void map_labels (void (*fn) (label *, void *), void *arg);
 void print_symbols ();
 void print_undefined_symbols ();
 label *record_label (char *name, mem_addr address, int resolve_uses);
@@ -58,6 +58,8 @@
 
 #ifndef WIN32
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <fcntl.h>
 #ifdef NEED_TERMIOS
 #include <sys/ioctl.h>
 #include <sgtty.h>
@@ -79,6 +81,7 @@
 #include "scanner.h"
 #include "parser_yacc.h"
 #include "data.h"
+#include "image.h"
 
 
 /* Internal functions: */
@@ -100,6 +103,7 @@ static int read_token ();
 static bool write_assembled_code(char* program_name);
 static void dump_data_seg (bool kernel_also);
 static void dump_text_seg (bool kernel_also);
+static int run_batch (char *manifest);
 
 
 /* Exported Variables: */
@@ -116,6 +120,9 @@ bool assemble;			/* => assemble, write to stdout and exit */
 char *exception_file_name = DEFAULT_EXCEPTION_HANDLER;
 port message_out, console_out, console_in;
 bool mapped_io;			/* => activate memory-mapped IO */
+bool threaded_code;		/* => execute pre-decoded threaded code */
+bool jit_code;			/* => compile hot blocks to machine code */
+bool wall_clock_timer;		/* => CP0 timer follows real time */
 int pipe_out;
 int spim_return_value;		/* Value returned when spim exits */
 
@@ -134,6 +141,9 @@ static int program_argc;
 static char** program_argv;
 static bool dump_user_segments = false;
 static bool dump_all_segments = false;
+static char *save_image_file = NULL;
+static char *batch_manifest = NULL;
+static int batch_jobs = 1;	/* Batch programs run at once, 0 => 1 per CPU */
 
 
 
@@ -158,6 +168,9 @@ main (int argc, char **argv)
   /* Input comes directly (not through stdio): */
   console_in.i = 0;
   mapped_io = false;
+  threaded_code = true;
+  jit_code = false;
+  wall_clock_timer = false;
 
   // write_startup_message ();
 
@@ -212,6 +225,22 @@ main (int argc, char **argv)
       else if (streq (argv [i], "-nomapped_io")
 	       || streq (argv [i], "-nmio"))
 	{ mapped_io = false; }
+      else if (streq (argv [i], "-threaded")
+	       || streq (argv [i], "-th"))
+	{ threaded_code = true; }
+      else if (streq (argv [i], "-nothreaded")
+	       || streq (argv [i], "-nth"))
+	{ threaded_code = false; }
+      else if (streq (argv [i], "-jit"))
+	{ threaded_code = true; jit_code = true; }
+      else if (streq (argv [i], "-nojit"))
+	{ jit_code = false; }
+      else if (streq (argv [i], "-wall_clock_timer")
+	       || streq (argv [i], "-wct"))
+	{ wall_clock_timer = true; }
+      else if (streq (argv [i], "-cycle_timer")
+	       || streq (argv [i], "-ct"))
+	{ wall_clock_timer = false; }
       else if (streq (argv [i], "-pseudo")
 	       || streq (argv [i], "-p"))
 	{ accept_pseudo_insts = true; }
@@ -278,12 +307,30 @@ main (int argc, char **argv)
 	  assembly_file_loaded = read_assembly_file (argv[++i]) || assembly_file_loaded;
 	  break;
 	}
+      else if (streq (argv [i], "-image")
+	       && (i + 1 < argc))
+	{
+	  program_argc = argc - (i + 1);
+	  program_argv = &argv[i + 1]; /* Everything following is argv */
+
+	  assembly_file_loaded = read_machine_image (argv[++i]);
+	  break;
+	}
       else if (streq (argv [i], "-assemble"))
 	{ assemble = true; }
+      else if (streq (argv [i], "-save_image")
+	       && (i + 1 < argc))
+	{ save_image_file = argv[++i]; }
       else if (streq (argv [i], "-dump"))
         { dump_user_segments = true; }
       else if (streq (argv [i], "-full_dump"))
         { dump_all_segments = true; }
+      else if (streq (argv [i], "-batch")
+	       && (i + 1 < argc))
+	{ batch_manifest = argv[++i]; }
+      else if (streq (argv [i], "-jobs")
+	       && (i + 1 < argc))
+	{ batch_jobs = atoi (argv[++i]); }
       else
 	{
 	  error ("\nUnknown argument: %s (ignored)\n", argv[i]);
@@ -305,12 +352,26 @@ main (int argc, char **argv)
 	-noquiet		Print warnings (default)\n\
 	-mapped_io		Enable memory-mapped IO\n\
 	-nomapped_io		Do not enable memory-mapped IO (default)\n\
+	-threaded		Execute pre-decoded threaded code (default)\n\
+	-nothreaded		Execute instructions with the decoding interpreter\n\
+	-jit			Compile frequently executed code to machine code\n\
+	-nojit			Do not compile code to machine code (default)\n\
+	-cycle_timer		CP0 timer counts instructions executed (default)\n\
+	-wall_clock_timer	CP0 timer counts real time\n\
 	-file <file> <args>	Assembly code file and arguments to program\n\
+	-image <file> <args>	Machine image file and arguments to program\n\
 	-assemble		Write assembled code to standard output\n\
+	-save_image <file>	Write machine image of loaded code to file\n\
 	-dump			Write user data and text segments into files\n\
-	-full_dump		Write user and kernel data and text into files.\n");
+	-full_dump		Write user and kernel data and text into files.\n\
+	-batch <manifest>	Run each program listed in manifest and summarize\n\
+	-jobs <n>		Run up to n batch programs at once (0 => one per processor)\n");
     }
 
+  if (batch_manifest != NULL)
+    {
+      return run_batch (batch_manifest);
+    }
 
   if (!assembly_file_loaded)
     {
@@ -324,6 +385,10 @@ main (int argc, char **argv)
        {
          return write_assembled_code (program_argv[0]);
        }
+     else if (save_image_file != NULL)
+       {
+         return !write_machine_image (save_image_file);
+       }
      else if (dump_user_segments)
        {
          dump_data_seg (false);
@@ -972,6 +1037,328 @@ write_assembled_code(char* program_name)
 
 
 
+/* Batch mode.  Each line of the manifest names an assembly file or
+   machine image, optionally followed by a file to use as the program's standard input
+   and a file holding its expected output ("-" for neither).  Blank lines
+   and lines starting with # are ignored.
+
+   The world (memory, registers, and exception handler) is initialized
+   once.  Each program then runs in a child process forked from that
+   state, so it starts from a copy of the initialized world without
+   re-reading the exception handler, and cannot disturb the programs
+   after it, even if it stops with a fatal error.  Since each machine has
+   its own process (memory, symbol table, and console buffers), up to
+   batch_jobs programs run at once on separate processors.  A line per
+   program and the totals are written to standard output. */
+
+#ifndef WIN32
+
+#define BATCH_RAN	0	/* Ran, no expected output to compare */
+#define BATCH_PASS	1	/* Output matched expected output */
+#define BATCH_FAIL	2	/* Output differed from expected output */
+#define BATCH_ERROR	3	/* Did not load or did not run to completion */
+
+static const char *batch_outcome_name [] = {"RAN", "PASS", "FAIL", "ERROR"};
+
+typedef struct batch_result
+{
+  int outcome;
+  int64 instructions;
+} batch_result;
+
+
+/* Return true if the contents of OUTPUT are the same as the file named
+   EXPECTED. */
+
+static bool
+batch_output_matches (FILE *output, char *expected)
+{
+  FILE *fp = fopen (expected, "rb");
+  int c1, c2;
+
+  if (fp == NULL)
+    {
+      perror (expected);
+      return (false);
+    }
+
+  rewind (output);
+  do
+    {
+      c1 = getc (output);
+      c2 = getc (fp);
+    }
+  while (c1 == c2 && c1 != EOF);
+
+  fclose (fp);
+  return (c1 == c2);
+}
+
+
+/* Run PROGRAM, in a child process, with its standard input read from
+   the file INPUT.  If EXPECTED is not NULL, compare the program's output
+   with the file it names.  Write the result to RESULT_FD and exit. */
+
+static void
+run_batch_program (char *program, char *input, char *expected, int result_fd)
+{
+  static batch_result result;	/* Static, since setjmp may return twice */
+  FILE *output = tmpfile ();
+  int fd = open (input != NULL ? input : "/dev/null", O_RDONLY);
+
+  result.outcome = BATCH_ERROR;
+  result.instructions = 0;
+
+  if (fd < 0)
+    perror (input);
+  else if (output == NULL)
+    perror ("tmpfile");
+  else
+    {
+      dup2 (fd, (int) console_in.i);
+      close (fd);
+      console_out.f = output;
+      message_out.f = stderr;
+
+      if (!setjmp (spim_top_level_env)
+	  && (is_machine_image (program)
+	      ? read_machine_image (program)
+	      : read_assembly_file (program) && !parse_error_occurred))
+	{
+	  bool continuable;
+	  char *undefs = undefined_symbol_string ();
+
+	  if (undefs != NULL)
+	    {
+	      write_output (message_out, "%s: the following symbols are undefined:\n", program);
+	      write_output (message_out, undefs);
+	      free (undefs);
+	    }
+	  initialize_run_stack (1, &program);
+	  run_program (find_symbol_address (DEFAULT_RUN_LOCATION), DEFAULT_RUN_STEPS, false, false, &continuable);
+	  if (continuable)
+	    error ("%s: did not finish in %d steps\n", program, DEFAULT_RUN_STEPS);
+	  else if (expected == NULL)
+	    result.outcome = BATCH_RAN;
+	  else if (batch_output_matches (output, expected))
+	    result.outcome = BATCH_PASS;
+	  else
+	    result.outcome = BATCH_FAIL;
+	}
+      result.instructions = instructions_executed;
+    }
+
+  if (write (result_fd, &result, sizeof (result)) != sizeof (result))
+    perror ("write");
+  _exit (0);
+}
+
+
+/* Return the seconds between times START and END. */
+
+static double
+elapsed_seconds (struct timeval *start, struct timeval *end)
+{
+  return ((end->tv_sec - start->tv_sec)
+	  + (end->tv_usec - start->tv_usec) / 1000000.0);
+}
+
+
+/* A program from the manifest and, once it has been started, the child
+   process running it. */
+
+typedef struct batch_job
+{
+  char *program;
+  char *input;			/* NULL => no input */
+  char *expected;		/* NULL => no expected output */
+  pid_t pid;
+  int result_fd;		/* Pipe from child */
+  struct timeval start;
+  double seconds;		/* Wall time, once done */
+  bool done;
+  batch_result result;
+} batch_job;
+
+
+/* Fork a child process to run JOB. */
+
+static void
+start_batch_job (batch_job *job)
+{
+  int fds[2];
+
+  job->result.outcome = BATCH_ERROR;
+  job->result.instructions = 0;
+  job->seconds = 0.0;
+  job->done = true;
+
+  gettimeofday (&job->start, NULL);
+  if (pipe (fds) < 0)
+    {
+      perror ("pipe");
+      return;
+    }
+  fflush (stdout);
+  fflush (stderr);
+  job->pid = fork ();
+  if (job->pid == 0)
+    {
+      close (fds[0]);
+      run_batch_program (job->program, job->input, job->expected, fds[1]);
+    }
+  close (fds[1]);
+  if (job->pid < 0)
+    {
+      perror ("fork");
+      close (fds[0]);
+      return;
+    }
+  job->result_fd = fds[0];
+  job->done = false;
+}
+
+
+/* Collect the result of JOB, whose child process has exited. */
+
+static void
+finish_batch_job (batch_job *job)
+{
+  struct timeval end;
+
+  /* A child that exits without reporting (e.g., from fatal_error) or is
+     killed by a signal is an error. */
+  if (read (job->result_fd, &job->result, sizeof (job->result))
+      != sizeof (job->result))
+    job->result.outcome = BATCH_ERROR;
+  close (job->result_fd);
+  gettimeofday (&end, NULL);
+  job->seconds = elapsed_seconds (&job->start, &end);
+  job->done = true;
+}
+
+
+/* Run every program in the file MANIFEST, with up to batch_jobs running
+   at once, and print a summary in the order of the manifest.  Return 0
+   if every program ran or passed, and 1 otherwise. */
+
+static int
+run_batch (char *manifest)
+{
+  FILE *fp = fopen (manifest, "rt");
+  char line [1024];
+  batch_job *jobs = NULL;
+  int job_count = 0, job_max = 0;
+  int started = 0, running = 0, reported = 0;
+  int parallel = batch_jobs;
+  int counts [4] = {0, 0, 0, 0};
+  int64 total_instructions = 0;
+  struct timeval batch_start, batch_end;
+
+  if (fp == NULL)
+    {
+      perror (manifest);
+      return (1);
+    }
+
+  while (fgets (line, sizeof (line), fp) != NULL)
+    {
+      char *program = strtok (line, " \t\r\n");
+      char *input = strtok (NULL, " \t\r\n");
+      char *expected = strtok (NULL, " \t\r\n");
+
+      if (program == NULL || program[0] == '#')
+	continue;
+
+      if (job_count == job_max)
+	{
+	  job_max = MAX (16, 2 * job_max);
+	  jobs = (batch_job *) realloc (jobs, job_max * sizeof (batch_job));
+	  if (jobs == NULL)
+	    fatal_error ("out of memory reading %s\n", manifest);
+	}
+      jobs[job_count].program = str_copy (program);
+      jobs[job_count].input = (input == NULL || streq (input, "-")
+			       ? NULL : str_copy (input));
+      jobs[job_count].expected = (expected == NULL || streq (expected, "-")
+				  ? NULL : str_copy (expected));
+      job_count += 1;
+    }
+  fclose (fp);
+
+  if (parallel <= 0)
+    parallel = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  parallel = MAX (parallel, 1);
+
+  initialize_world (load_exception_handler ? exception_file_name : NULL, false);
+
+  gettimeofday (&batch_start, NULL);
+  while (reported < job_count)
+    {
+      if (started < job_count && running < parallel)
+	{
+	  start_batch_job (&jobs[started]);
+	  if (!jobs[started].done)
+	    running += 1;
+	  started += 1;
+	}
+      else
+	{
+	  pid_t pid = waitpid (-1, NULL, 0);
+	  int i;
+
+	  if (pid < 0)
+	    {
+	      perror ("waitpid");
+	      break;
+	    }
+	  for (i = reported; i < started; i++)
+	    if (!jobs[i].done && jobs[i].pid == pid)
+	      {
+		finish_batch_job (&jobs[i]);
+		running -= 1;
+		break;
+	      }
+	}
+
+      /* Report in manifest order, as soon as earlier programs are done. */
+      while (reported < job_count && jobs[reported].done)
+	{
+	  batch_job *job = &jobs[reported];
+
+	  counts[job->result.outcome] += 1;
+	  total_instructions += job->result.instructions;
+	  write_output (message_out, "%-5s %s  %lld instructions  %.3f s\n",
+			batch_outcome_name[job->result.outcome], job->program,
+			job->result.instructions, job->seconds);
+	  reported += 1;
+	}
+    }
+  gettimeofday (&batch_end, NULL);
+
+  write_output (message_out,
+		"%d programs: %d passed, %d failed, %d ran, %d errors  %lld instructions  %.3f s\n",
+		reported, counts[BATCH_PASS], counts[BATCH_FAIL],
+		counts[BATCH_RAN], counts[BATCH_ERROR], total_instructions,
+		elapsed_seconds (&batch_start, &batch_end));
+
+  return ((counts[BATCH_FAIL] + counts[BATCH_ERROR]) != 0
+	  || reported < job_count);
+}
+
+#else
+
+static int
+run_batch (char *manifest)
+{
+  error ("Batch mode is not supported on this system\n");
+  return (1);
+}
+
+#endif
+
+
+
 /* Print an error message. */
 
 void
@@ -0,0 +1,221 @@
+#ifndef _DWISLPY_IR_TEST_HH
+#define _DWISLPY_IR_TEST_HH
+
+//
+// tests/ir-test.hh
+//
+// Helpers for the IR-level tests of the compiler's passes.
+//
+// The grammar doesn't yet have calls, `if`, or `while`, so the passes
+// that work on calls and loops can't be reached from a DWISLPY source
+// file. Each test instead builds IR by hand, runs a pass over it, and
+// checks both the shape of the code that results and, with `run_ir`,
+// that running it gives the same output as before.
+//
+//  * expect(ok,what) - counts and reports a failed check.
+//  * ir_defn(glbl,name,frmls) - a `def` of `int` formals `frmls`.
+//  * ir_symt(glbl,locls) - a symbol table for a main script of `int`
+//           locals `locls`.
+//  * ir_code(name,body) - `body` between the entry and exit of `name`,
+//           laid out as `Prgm::trans` lays it out. A return from it is
+//           `RTN` followed by a `JMP` to `name_done`.
+//  * run_ir(defs,code,input) - runs `code`, calling into `defs`, with
+//           `GTI` reading from `input`, and gives what `PTI` printed.
+//  * ir_outputs(defs,code,inputs) - what `run_ir` gives for each input.
+//  * count_of<T>(code) - the number of `T` instructions in `code`.
+//  * report(name) - prints a summary and gives the exit status.
+//
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+#include "dwislpy-ast.hh"
+#include "dwislpy-inst.hh"
+#include "dwislpy-check.hh"
+
+static int failures = 0;
+
+inline void expect(bool ok, std::string what) {
+    if (!ok) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+inline Defn_ptr ir_defn(SymT_ptr glbl, Name name, std::vector<Name> frmls) {
+    SymT symt { };
+    symt.set_parent(glbl);
+    for (Name frml : frmls) {
+        symt.add_frml(frml, IntTy {});
+    }
+    return Defn_ptr {new Defn {name, symt, IntTy {}, nullptr, Locn {"test"}}};
+}
+
+inline SymT ir_symt(SymT_ptr glbl, std::vector<Name> locls) {
+    SymT symt { };
+    symt.set_parent(glbl);
+    for (Name locl : locls) {
+        symt.add_locl(locl, IntTy {});
+    }
+    return symt;
+}
+
+inline INST_vec ir_code(Name name, INST_vec body) {
+    INST_vec code { new LBL {name}, new ENTER {} };
+    code.insert(code.end(), body.begin(), body.end());
+    code.push_back(new LBL {name + "_done"});
+    code.push_back(new LEAVE {});
+    return code;
+}
+
+template <class T>
+int count_of(const INST_vec& code) {
+    int count = 0;
+    for (INST_ptr inst : code) {
+        if (dynamic_cast<T*>(inst) != nullptr) {
+            count++;
+        }
+    }
+    return count;
+}
+
+//
+// class IRMachine
+//
+// A small interpreter for the IR, just enough to run the code built by
+// the tests. An `ADD` or `SUB` that overflows throws, as it traps on
+// MIPS. A run that takes too many steps throws too, so that a pass
+// that breaks a loop doesn't hang the test.
+//
+class IRMachine {
+public:
+    IRMachine(const Defs& ds, std::vector<int> in) :
+        defs {ds}, input {in}, next {0}, output {}, steps {0} { }
+    int call(const INST_vec& code, std::unordered_map<Symb,int> vars);
+    std::vector<int> printed(void) const { return output; }
+private:
+    const Defs& defs;
+    std::vector<int> input;
+    unsigned int next;
+    std::vector<int> output;
+    long steps;
+};
+
+inline bool ir_holds(std::string cndn, int v1, int v2) {
+    if (cndn == "lt") return v1 < v2;
+    if (cndn == "le") return v1 <= v2;
+    if (cndn == "gt") return v1 > v2;
+    if (cndn == "ge") return v1 >= v2;
+    if (cndn == "eq") return v1 == v2;
+    return v1 != v2;
+}
+
+inline int IRMachine::call(const INST_vec& code,
+                           std::unordered_map<Symb,int> vars) {
+    std::unordered_map<Symb,unsigned int> label_at { };
+    for (unsigned int i = 0; i < code.size(); i++) {
+        if (LBL* lbl = dynamic_cast<LBL*>(code[i])) {
+            label_at[lbl->lbl] = i;
+        }
+    }
+    auto go = [&](Symb lbl) {
+        if (label_at.count(lbl) == 0) {
+            throw std::runtime_error {"no label " + lbl.name()};
+        }
+        return label_at.at(lbl);
+    };
+    std::unordered_map<int,int> args { };
+    int result = 0;
+    int returned = 0;
+    unsigned int pc = 0;
+    while (pc < code.size()) {
+        if (++steps > 1000000) {
+            throw std::runtime_error {"too many steps"};
+        }
+        INST_ptr inst = code[pc++];
+        if (SET* set = dynamic_cast<SET*>(inst)) {
+            vars[set->dst] = set->val;
+        } else if (STL* stl = dynamic_cast<STL*>(inst)) {
+            vars[stl->dst] = 0;
+        } else if (MOV* mov = dynamic_cast<MOV*>(inst)) {
+            vars[mov->dst] = vars[mov->src];
+        } else if (ADD* add = dynamic_cast<ADD*>(inst)) {
+            long long v = (long long)vars[add->src1] + vars[add->src2];
+            if (v != (int)v) {
+                throw std::overflow_error {"add"};
+            }
+            vars[add->dst] = (int)v;
+        } else if (SUB* sub = dynamic_cast<SUB*>(inst)) {
+            long long v = (long long)vars[sub->src1] - vars[sub->src2];
+            if (v != (int)v) {
+                throw std::overflow_error {"sub"};
+            }
+            vars[sub->dst] = (int)v;
+        } else if (BCN* bcn = dynamic_cast<BCN*>(inst)) {
+            bool taken = ir_holds(bcn->cndn, vars[bcn->src1], vars[bcn->src2]);
+            pc = go(taken ? bcn->lblt : bcn->lblf);
+        } else if (BCZ* bcz = dynamic_cast<BCZ*>(inst)) {
+            std::string cndn = bcz->cndn.substr(0,bcz->cndn.size()-1);
+            bool taken = ir_holds(cndn, vars[bcz->src], 0);
+            pc = go(taken ? bcz->lblt : bcz->lblf);
+        } else if (JMP* jmp = dynamic_cast<JMP*>(inst)) {
+            pc = go(jmp->lbl);
+        } else if (ARG* arg = dynamic_cast<ARG*>(inst)) {
+            args[arg->idx] = vars[arg->src];
+        } else if (CLL* cll = dynamic_cast<CLL*>(inst)) {
+            Defn_ptr callee = defs.at(cll->lbl.name());
+            std::unordered_map<Symb,int> frame { };
+            for (unsigned int i = 0; i < callee->arity(); i++) {
+                frame[callee->formal(i)->name] = args[i];
+            }
+            args.clear();
+            returned = call(callee->code, frame);
+        } else if (RTV* rtv = dynamic_cast<RTV*>(inst)) {
+            vars[rtv->dst] = returned;
+        } else if (RTN* rtn = dynamic_cast<RTN*>(inst)) {
+            result = vars[rtn->src];
+        } else if (GTI* gti = dynamic_cast<GTI*>(inst)) {
+            vars[gti->dst] = next < input.size() ? input[next++] : 0;
+        } else if (PTI* pti = dynamic_cast<PTI*>(inst)) {
+            output.push_back(vars[pti->src]);
+        } else if (dynamic_cast<LEAVE*>(inst) != nullptr) {
+            break;
+        }
+    }
+    return result;
+}
+
+inline std::vector<int> run_ir(const Defs& defs, const INST_vec& code,
+                               std::vector<int> input) {
+    IRMachine machine {defs, input};
+    machine.call(code, {});
+    return machine.printed();
+}
+
+inline std::vector<std::vector<int>> ir_outputs(const Defs& defs,
+                                               const INST_vec& code,
+                                               std::vector<std::vector<int>> inputs) {
+    std::vector<std::vector<int>> outs { };
+    for (std::vector<int> input : inputs) {
+        try {
+            outs.push_back(run_ir(defs, code, input));
+        } catch (std::exception& e) {
+            expect(false, std::string {"running the code: "} + e.what());
+        }
+    }
+    return outs;
+}
+
+inline int report(std::string name) {
+    if (failures == 0) {
+        std::cout << name << ": ok" << std::endl;
+        return 0;
+    }
+    std::cout << name << ": " << failures << " failed" << std::endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include <string>
+#include <vector>
+
+#include "dwislpy-ast.hh"
+#include "dwislpy-inln.hh"
+#include "ir-test.hh"
+
+//
+// tests/test-inln.cc
+//
+// Tests of `inline_calls` (see `dwislpy-inln.hh`) on hand-built IR.
+//
+// The callee `f(a,b)` gives `a+b` if that's less than 10, and `b`
+// otherwise. The callee `g(a)` gives `h(a)`, where `h(a)` gives `a+1`,
+// and so `g` only becomes a leaf once `h` is inlined into it. The
+// callee `big(a)` is too long to be worth inlining. Each main script
+// reads `x` and prints `y`, the callee of `x` (and `5`), and then the
+// callee of `y` (and `y`).
+//
+
+const std::vector<std::vector<int>> INPUTS { {3}, {20}, {-4}, {0} };
+
+INST_vec calls_of(Name callee, unsigned int arity) {
+    INST_vec body { new GTI {"x"}, new SET {"c",5} };
+    auto call = [&](Name a0, Name a1, Name dst) {
+        body.push_back(new ARG {0,a0});
+        if (arity > 1) {
+            body.push_back(new ARG {1,a1});
+        }
+        body.push_back(new CLL {callee});
+        body.push_back(new RTV {dst});
+        body.push_back(new PTI {dst});
+    };
+    call("x","c","y");
+    call("y","y","z");
+    return ir_code("main", body);
+}
+
+int main(void) {
+    SymT_ptr glbl { new SymT {} };
+
+    Defn_ptr f = ir_defn(glbl, "f", {"a","b"});
+    Name t = f->symt.add_temp(IntTy {});
+    Name ten = f->symt.add_temp(IntTy {});
+    f->code = ir_code("f", {
+        new ADD {t,"a","b"}, new SET {ten,10},
+        new BCN {"lt",t,ten,"small","large"},
+        new LBL {"small"}, new RTN {t}, new JMP {"f_done"},
+        new LBL {"large"}, new RTN {"b"}, new JMP {"f_done"}
+    });
+
+    Defn_ptr h = ir_defn(glbl, "h", {"a"});
+    Name one = h->symt.add_temp(IntTy {});
+    Name s = h->symt.add_temp(IntTy {});
+    h->code = ir_code("h", {
+        new SET {one,1}, new ADD {s,"a",one}, new RTN {s}, new JMP {"h_done"}
+    });
+
+    Defn_ptr g = ir_defn(glbl, "g", {"a"});
+    Name r = g->symt.add_temp(IntTy {});
+    g->code = ir_code("g", {
+        new ARG {0,"a"}, new CLL {"h"}, new RTV {r},
+        new RTN {r}, new JMP {"g_done"}
+    });
+
+    Defn_ptr big = ir_defn(glbl, "big", {"a"});
+    Name u = big->symt.add_temp(IntTy {});
+    INST_vec body { new MOV {u,"a"} };
+    for (int i = 0; i < 30; i++) {
+        body.push_back(new ADD {u,u,"a"});
+    }
+    body.push_back(new RTN {u});
+    body.push_back(new JMP {"big_done"});
+    big->code = ir_code("big", body);
+
+    Defs defs { {"f", f}, {"g", g}, {"h", h}, {"big", big} };
+
+    // A small leaf is inlined at each call, and the results are the
+    // same.
+    //
+    SymT fms = ir_symt(glbl, {"x","y","z","c"});
+    INST_vec fcode = calls_of("f", 2);
+    std::vector<std::vector<int>> fexpected = ir_outputs(defs, fcode, INPUTS);
+    expect(inline_calls(defs, fms, fcode), "f is inlined");
+    expect(count_of<CLL>(fcode) == 0, "no calls of f are left");
+    expect(count_of<ARG>(fcode) == 0 && count_of<RTV>(fcode) == 0,
+           "the ARGs and RTVs of f's calls are gone");
+    expect(count_of<ENTER>(fcode) == 1 && count_of<LEAVE>(fcode) == 1,
+           "f's ENTER and LEAVE are not copied in");
+    expect(ir_outputs(defs, fcode, INPUTS) == fexpected,
+           "inlining f keeps the output");
+
+    // A callee that makes calls is left alone, until the calls inside
+    // it are inlined.
+    //
+    SymT gms = ir_symt(glbl, {"x","y","z","c"});
+    INST_vec gcode = calls_of("g", 1);
+    std::vector<std::vector<int>> gexpected = ir_outputs(defs, gcode, INPUTS);
+    expect(!inline_calls(defs, gms, gcode), "g is not inlined while it calls");
+    expect(count_of<CLL>(gcode) == 2, "both calls of g are kept");
+    expect(inline_calls(defs, g->symt, g->code), "h is inlined into g");
+    expect(count_of<CLL>(g->code) == 0, "g no longer calls h");
+    expect(inline_calls(defs, gms, gcode), "g is inlined once it's a leaf");
+    expect(count_of<CLL>(gcode) == 0, "no calls of g are left");
+    expect(ir_outputs(defs, gcode, INPUTS) == gexpected,
+           "inlining g keeps the output");
+
+    // A callee bigger than a call costs plus INLINE_SIZE is not inlined.
+    //
+    SymT bms = ir_symt(glbl, {"x","y","z","c"});
+    INST_vec bcode = calls_of("big", 1);
+    expect(!inline_calls(defs, bms, bcode), "big is not inlined");
+    expect(count_of<CLL>(bcode) == 2, "both calls of big are kept");
+
+    return report("test-inln");
+}
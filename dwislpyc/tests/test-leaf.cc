@@ -0,0 +1,86 @@
+#include <sstream>
+#include <string>
+
+#include "dwislpy-ast.hh"
+#include "dwislpy-regs.hh"
+#include "ir-test.hh"
+
+//
+// tests/test-leaf.cc
+//
+// Tests of the frames given to leaf `def`s by `allocate_registers` and
+// `compile_defn` (see `dwislpy-regs.hh` and `dwislpy-mips.cc`).
+//
+// The callee `f(a,b)` gives `a+b`. It makes no calls and all its
+// variables fit in registers, so it should get no frame at all. The
+// callee `p(a)` prints `a` before giving it back, and so can't keep `a`
+// in `$a0`. The callee `g(a)` gives `f(a,a)`, and so isn't a leaf.
+//
+
+void compile_defn(std::ostream& os, SymT& symt, INST_vec& code);
+
+std::string compile(Defn_ptr defn) {
+    allocate_registers(defn->symt, defn->code);
+    share_frame_slots(defn->symt, defn->code);
+    std::stringstream mips { };
+    compile_defn(mips, defn->symt, defn->code);
+    return mips.str();
+}
+
+bool emits(std::string mips, std::string text) {
+    return mips.find(text) != std::string::npos;
+}
+
+int main(void) {
+    SymT_ptr glbl { new SymT {} };
+
+    Defn_ptr f = ir_defn(glbl, "f", {"a","b"});
+    Name t = f->symt.add_temp(IntTy {});
+    f->code = ir_code("f", {
+        new ADD {t,"a","b"}, new RTN {t}, new JMP {"f_done"}
+    });
+
+    Defn_ptr p = ir_defn(glbl, "p", {"a"});
+    p->code = ir_code("p", {
+        new PTI {"a"}, new RTN {"a"}, new JMP {"p_done"}
+    });
+
+    Defn_ptr g = ir_defn(glbl, "g", {"a"});
+    Name r = g->symt.add_temp(IntTy {});
+    g->code = ir_code("g", {
+        new ARG {0,"a"}, new ARG {1,"a"}, new CLL {"f"}, new RTV {r},
+        new RTN {r}, new JMP {"g_done"}
+    });
+
+    expect(is_leaf(f->code), "f is a leaf");
+    expect(is_leaf(p->code), "p is a leaf");
+    expect(!is_leaf(g->code), "g is not a leaf");
+
+    // A leaf keeps its formals in the registers they're passed in, and
+    // one with nothing in its frame gets no frame.
+    //
+    std::string fmips = compile(f);
+    expect(f->symt.is_leaf(), "f is recorded as a leaf");
+    expect(f->symt.get_register("a") == "$a0", "f keeps a in $a0");
+    expect(f->symt.get_register("b") == "$a1", "f keeps b in $a1");
+    expect(f->symt.get_frame_size() == 0, "f has no frame");
+    expect(!emits(fmips, "$ra,"), "f doesn't save or restore $ra");
+    expect(!emits(fmips, "$sp"), "f doesn't touch $sp");
+    expect(emits(fmips, "jr $ra"), "f returns");
+
+    // A leaf that prints gives up $a0, but it still doesn't save $ra.
+    //
+    std::string pmips = compile(p);
+    expect(p->symt.get_register("a") != "$a0", "p doesn't keep a in $a0");
+    expect(!emits(pmips, "$ra,"), "p doesn't save or restore $ra");
+
+    // A def that makes calls saves $ra in its frame.
+    //
+    std::string gmips = compile(g);
+    expect(!g->symt.is_leaf(), "g is not recorded as a leaf");
+    expect(g->symt.get_frame_size() > 0, "g has a frame");
+    expect(emits(gmips, "sw $ra,") && emits(gmips, "lw $ra,"),
+           "g saves and restores $ra");
+
+    return report("test-leaf");
+}
@@ -0,0 +1,96 @@
+#include <string>
+#include <vector>
+
+#include "dwislpy-opt.hh"
+#include "ir-test.hh"
+
+//
+// tests/test-licm.cc
+//
+// Tests of the loop-invariant code motion of `optimize` (see
+// `dwislpy-opt.hh`) on hand-built IR, with the other passes off.
+//
+// Each main script reads `n` and loops while `n > 0`, taking one from
+// `n` each time around. The first sets `k` to 3 and adds it to `s` in
+// its loop, and that `SET` should move out. The second adds `big+big`
+// on a path through its loop that's never taken. That `ADD` would
+// overflow, and so it must stay where it is.
+//
+
+const std::vector<std::vector<int>> INPUTS { {0}, {1}, {5} };
+
+// The instructions of the block labelled `lbl`.
+INST_vec block_at(const INST_vec& code, Name lbl) {
+    INST_vec block { };
+    bool in = false;
+    for (INST_ptr inst : code) {
+        if (LBL* l = dynamic_cast<LBL*>(inst)) {
+            in = l->lbl == lbl;
+        }
+        if (in) {
+            block.push_back(inst);
+        }
+    }
+    return block;
+}
+
+bool sets(const INST_vec& code, int val) {
+    for (INST_ptr inst : code) {
+        SET* set = dynamic_cast<SET*>(inst);
+        if (set != nullptr && set->val == val) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(void) {
+    SymT_ptr glbl { new SymT {} };
+    Opts licm { };
+    licm.cnst_prop = false;
+    licm.copy_prop = false;
+    licm.cse = false;
+    licm.dce = false;
+
+    // An invariant SET is moved out of the loop.
+    //
+    SymT cs = ir_symt(glbl, {"n","zero","s","k","one"});
+    INST_vec count = ir_code("main", {
+        new GTI {"n"}, new SET {"zero",0}, new SET {"s",0},
+        new BCN {"gt","n","zero","H","E"},
+        new LBL {"H"}, new SET {"k",3}, new ADD {"s","s","k"},
+        new SET {"one",1}, new SUB {"n","n","one"},
+        new BCN {"gt","n","zero","H","E"},
+        new LBL {"E"}, new PTI {"s"}
+    });
+    std::vector<std::vector<int>> cexpected = ir_outputs({}, count, INPUTS);
+    optimize(cs, count, licm);
+    expect(!block_at(count, "H").empty(), "the loop is still there");
+    expect(!sets(block_at(count, "H"), 3), "k is set before the loop");
+    expect(sets(count, 3), "k is still set");
+    expect(ir_outputs({}, count, INPUTS) == cexpected,
+           "hoisting keeps the output");
+
+    // An ADD that is not run on every trip stays put.
+    //
+    SymT gs = ir_symt(glbl, {"n","zero","s","big","one","t"});
+    INST_vec guarded = ir_code("main", {
+        new GTI {"n"}, new SET {"zero",0}, new SET {"s",0},
+        new SET {"big",2147483647}, new SET {"one",1},
+        new BCN {"gt","n","zero","H","E"},
+        new LBL {"H"}, new BCN {"lt","n","zero","A","L"},
+        new LBL {"A"}, new ADD {"t","big","big"}, new MOV {"s","t"},
+        new JMP {"L"},
+        new LBL {"L"}, new SUB {"n","n","one"},
+        new BCN {"gt","n","zero","H","E"},
+        new LBL {"E"}, new PTI {"s"}
+    });
+    std::vector<std::vector<int>> gexpected = ir_outputs({}, guarded, INPUTS);
+    optimize(gs, guarded, licm);
+    expect(count_of<ADD>(block_at(guarded, "A")) == 1,
+           "the ADD stays in its block");
+    expect(ir_outputs({}, guarded, INPUTS) == gexpected,
+           "the ADD still doesn't trap");
+
+    return report("test-licm");
+}
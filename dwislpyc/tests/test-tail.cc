@@ -0,0 +1,117 @@
+#include <string>
+#include <vector>
+
+#include "dwislpy-ast.hh"
+#include "dwislpy-inln.hh"
+#include "ir-test.hh"
+
+//
+// tests/test-tail.cc
+//
+// Tests of `eliminate_tail_calls` (see `dwislpy-inln.hh`) on hand-built
+// IR.
+//
+// The callee `sum(n,acc)` gives `acc` if `n < 1`, and otherwise gives
+// `sum(n-1,acc+n)`. The callee `alt(n,a,b)` gives `a` if `n < 1`, and
+// otherwise gives `alt(n-1,b,a)`, and so swaps two of its formals on
+// each call. The callee `tri(n)` gives `0` if `n < 1`, and otherwise
+// gives `n + tri(n-1)`, and so its call is not a tail call. The main
+// script reads `x` and prints what the callee gives for `x`, `7`, and
+// `-3`.
+//
+
+const std::vector<std::vector<int>> INPUTS { {0}, {1}, {2}, {5}, {10} };
+
+INST_vec call_of(Name callee, int arity) {
+    INST_vec body { new GTI {"x"}, new SET {"c",7}, new SET {"d",-3} };
+    std::vector<Name> args { "x", "c", "d" };
+    for (int i = 0; i < arity; i++) {
+        body.push_back(new ARG {i,args[i]});
+    }
+    body.push_back(new CLL {callee});
+    body.push_back(new RTV {"y"});
+    body.push_back(new PTI {"y"});
+    return ir_code("main", body);
+}
+
+bool jumps_to(const INST_vec& code, Name lbl) {
+    for (INST_ptr inst : code) {
+        JMP* jmp = dynamic_cast<JMP*>(inst);
+        if (jmp != nullptr && jmp->lbl == lbl) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(void) {
+    SymT_ptr glbl { new SymT {} };
+
+    Defn_ptr sum = ir_defn(glbl, "sum", {"n","acc"});
+    Name one = sum->symt.add_temp(IntTy {});
+    Name n1 = sum->symt.add_temp(IntTy {});
+    Name acc1 = sum->symt.add_temp(IntTy {});
+    Name r = sum->symt.add_temp(IntTy {});
+    sum->code = ir_code("sum", {
+        new SET {one,1}, new BCN {"lt","n",one,"base","step"},
+        new LBL {"base"}, new RTN {"acc"}, new JMP {"sum_done"},
+        new LBL {"step"}, new SUB {n1,"n",one}, new ADD {acc1,"acc","n"},
+        new ARG {0,n1}, new ARG {1,acc1}, new CLL {"sum"}, new RTV {r},
+        new RTN {r}, new JMP {"sum_done"}
+    });
+
+    Defn_ptr alt = ir_defn(glbl, "alt", {"n","a","b"});
+    one = alt->symt.add_temp(IntTy {});
+    n1 = alt->symt.add_temp(IntTy {});
+    r = alt->symt.add_temp(IntTy {});
+    alt->code = ir_code("alt", {
+        new SET {one,1}, new BCN {"lt","n",one,"base","step"},
+        new LBL {"base"}, new RTN {"a"}, new JMP {"alt_done"},
+        new LBL {"step"}, new SUB {n1,"n",one},
+        new ARG {0,n1}, new ARG {1,"b"}, new ARG {2,"a"},
+        new CLL {"alt"}, new RTV {r}, new RTN {r}, new JMP {"alt_done"}
+    });
+
+    Defn_ptr tri = ir_defn(glbl, "tri", {"n"});
+    one = tri->symt.add_temp(IntTy {});
+    n1 = tri->symt.add_temp(IntTy {});
+    r = tri->symt.add_temp(IntTy {});
+    Name t = tri->symt.add_temp(IntTy {});
+    tri->code = ir_code("tri", {
+        new SET {one,1}, new BCN {"lt","n",one,"base","step"},
+        new LBL {"base"}, new SET {t,0}, new RTN {t}, new JMP {"tri_done"},
+        new LBL {"step"}, new SUB {n1,"n",one},
+        new ARG {0,n1}, new CLL {"tri"}, new RTV {r}, new ADD {t,"n",r},
+        new RTN {t}, new JMP {"tri_done"}
+    });
+
+    Defs defs { {"sum", sum}, {"alt", alt}, {"tri", tri} };
+
+    // A returned self call becomes a jump back to the top.
+    //
+    INST_vec scode = call_of("sum", 2);
+    std::vector<std::vector<int>> sexpected = ir_outputs(defs, scode, INPUTS);
+    expect(eliminate_tail_calls(*sum), "sum's tail call is replaced");
+    expect(count_of<CLL>(sum->code) == 0, "sum no longer calls itself");
+    expect(count_of<ARG>(sum->code) == 0 && count_of<RTV>(sum->code) == 0,
+           "the ARGs and RTV of sum's call are gone");
+    expect(jumps_to(sum->code, "sum_top"), "sum jumps to sum_top");
+    expect(ir_outputs(defs, scode, INPUTS) == sexpected,
+           "the loop in sum gives the same");
+
+    // Formals that are passed to each other are swapped, not
+    // overwritten.
+    //
+    INST_vec acode = call_of("alt", 3);
+    std::vector<std::vector<int>> aexpected = ir_outputs(defs, acode, INPUTS);
+    expect(eliminate_tail_calls(*alt), "alt's tail call is replaced");
+    expect(ir_outputs(defs, acode, INPUTS) == aexpected,
+           "the loop in alt gives the same");
+
+    // A self call whose result is used is left alone.
+    //
+    expect(!eliminate_tail_calls(*tri), "tri's call is not a tail call");
+    expect(count_of<CLL>(tri->code) == 1, "tri still calls itself");
+
+    return report("test-tail");
+}